@@ -43,6 +43,9 @@
 #if ETH_ETHASHCUDA
 #include <libethash-cuda/CUDAMiner.h>
 #endif
+#if ETH_ETHASHCPU
+#include <libethash-cpu/CPUMiner.h>
+#endif
 #include <libpoolprotocols/PoolManager.h>
 #include <libpoolprotocols/stratum/EthStratumClient.h>
 #include <libpoolprotocols/getwork/EthGetworkClient.h>
@@ -337,10 +340,87 @@ public:
 			if ((i + 1 < argc) && (*argv[i + 1] != '-'))
 				m_show_power = atoi(argv[++i]) != 0;
 		}
+		else if (arg == "--hwmon-interval" && i + 1 < argc)
+		{
+			try {
+				m_hwmonIntervalMs = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
 		else if ((arg == "--exit"))
 		{
 			m_exit = true;
 		}
+		else if (arg == "--epoch-prefetch" && i + 1 < argc)
+		{
+			try {
+				m_epochPrefetchMB = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
+		else if (arg == "--light-cache" && i + 1 < argc)
+		{
+			try {
+				m_lightCacheCapacity = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
+		else if (arg == "--dag-dir")
+		{
+			m_dagDir = EpochStore::defaultDirectory();
+			if ((i + 1 < argc) && (*argv[i + 1] != '-'))
+				m_dagDir = argv[++i];
+		}
+		else if (arg == "--shm")
+		{
+			m_shareEpochs = true;
+		}
+		else if (arg == "--lock-memory")
+		{
+			m_lockMemory = true;
+		}
+		else if (arg == "--numa")
+		{
+			m_numa = true;
+		}
+		else if (arg == "--lazy-dag")
+		{
+			m_lazyDag = true;
+		}
+		else if (arg == "--item-cache" && i + 1 < argc)
+		{
+			try {
+				m_itemCacheMB = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
+		else if (arg == "--dag-keep" && i + 1 < argc)
+		{
+			try {
+				m_dagKeep = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
 		else if ((arg == "-P") && (i + 1 < argc))
 		{
 			m_newParameters = true;
@@ -464,7 +544,7 @@ public:
 				BOOST_THROW_EXCEPTION(BadArgument());
 			}
 #endif
-#if ETH_ETHASHCL || ETH_ETHASHCUDA
+#if ETH_ETHASHCL || ETH_ETHASHCUDA || ETH_ETHASHCPU
 		else if (arg == "--list-devices")
 			m_shouldListDevices = true;
 #endif
@@ -554,6 +634,39 @@ public:
 				BOOST_THROW_EXCEPTION(BadArgument());
 			}
 		}
+		else if (arg == "--dag-parallel" && i + 1 < argc)
+		{
+			try {
+				m_dagParallel = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
+		else if (arg == "--dag-host-memory" && i + 1 < argc)
+		{
+			try {
+				m_dagHostMemoryMB = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
+		else if (arg == "--verify-threads" && i + 1 < argc)
+		{
+			try {
+				m_verifyThreads = stol(argv[++i]);
+			}
+			catch (...)
+			{
+				cerr << "Bad " << arg << " option: " << argv[i] << endl;
+				BOOST_THROW_EXCEPTION(BadArgument());
+			}
+		}
 		else if (arg == "--benchmark-warmup" && i + 1 < argc)
 			try {
 				m_benchmarkWarmup = stol(argv[++i]);
@@ -592,6 +705,20 @@ public:
 		{
 			m_minerType = MinerType::Mixed;
 		}
+		else if (arg == "-C" || arg == "--cpu")
+		{
+			m_minerType = MinerType::CPU;
+			if ((i + 1 < argc) && (*argv[i + 1] != '-'))
+				try
+				{
+					m_cpuThreads = stol(argv[++i]);
+				}
+				catch (...)
+				{
+					cerr << "Bad " << arg << " option: " << argv[i] << endl;
+					BOOST_THROW_EXCEPTION(BadArgument());
+				}
+		}
 		else if (arg == "-M" || arg == "--benchmark")
 		{
 			m_mode = OperationMode::Benchmark;
@@ -668,6 +795,10 @@ public:
 #if ETH_ETHASHCUDA
 			if (m_minerType == MinerType::CUDA || m_minerType == MinerType::Mixed)
 				CUDAMiner::listDevices();
+#endif
+#if ETH_ETHASHCPU
+			if (m_minerType == MinerType::CPU)
+				CPUMiner::listDevices();
 #endif
 			exit(0);
 		}
@@ -677,6 +808,21 @@ public:
 		minelog << "Build: " << build->system_name << "/" << build->build_type
 			 << "+git." << string(build->git_commit_hash).substr(0, 7);
 
+		EthashAux::setLightCacheCapacity(m_lightCacheCapacity);
+		EpochPrefetcher::setMemoryBudget(m_epochPrefetchMB << 20);
+		EpochStore::setDirectory(m_dagDir);
+		EpochStore::setKeep(m_dagKeep);
+		EpochShare::setEnabled(m_shareEpochs);
+		LargeBuffer::setLockMemory(m_lockMemory);
+		EthashAux::setNumaReplication(m_numa);
+		EthashAux::setLazyDataset(m_lazyDag);
+		EthashAux::setItemCacheSize(m_itemCacheMB << 20);
+		// Sequential mode is one load at a time, unless a number is given.
+		DagLoadScheduler::get().setBudget(
+			m_dagParallel ? m_dagParallel : (m_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL ? 1 : 0), m_dagHostMemoryMB << 20);
+		SolutionVerifier::setThreads(m_verifyThreads);
+		HwMonitorSampler::setInterval(m_hwmonIntervalMs);
+
 		if (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed)
 		{
 #if ETH_ETHASHCL
@@ -734,6 +880,17 @@ public:
 			exit(1);
 #endif
 		}
+		if (m_minerType == MinerType::CPU)
+		{
+#if ETH_ETHASHCPU
+			CPUMiner::setNumInstances(m_cpuThreads ? m_cpuThreads : m_miningThreads);
+			if (!CPUMiner::configureCPU(0, m_exit))
+				exit(1);
+#else
+			cerr << "CPU support disabled. Configure project build with -DETHASHCPU=ON" << endl;
+			exit(1);
+#endif
+		}
 
 		g_running = true;
 		signal(SIGINT, MinerCLI::signalHandler);
@@ -765,7 +922,19 @@ public:
 			<< "    -HWMON [<n>], Displays gpu temp, fan percent and power usage. Note: In linux, the program uses sysfs, which may require running with root privileges." << endl
 			<< "        0: Displays only temp and fan percent (default)" << endl
 			<< "        1: Also displays power usage" << endl
+			<< "    --hwmon-interval <ms> Time between reads of the gpu temp, fan and power for -HWMON and the API, 0 to disable (default: " << HwMonitorSampler::c_defaultIntervalMs << ")" << endl
 			<< "    --exit Stops the miner whenever an error is encountered" << endl
+			<< "    --epoch-prefetch <n> Memory in MB that may be used to prepare the next epoch in the background, 0 to disable (default: " << EpochPrefetcher::c_defaultBudgetMB << ")." << endl
+			<< "        With -C the next DAG is prepared as well if it fits. Work packages carry no block number, so this starts as soon as" << endl
+			<< "        an epoch begins rather than near its end: the next epoch's data then stays in memory for the whole epoch." << endl
+			<< "    --light-cache <n> Number of epoch light caches kept in memory (default: " << EthashAux::c_defaultLightCacheCapacity << ")" << endl
+			<< "    --dag-dir [<dir>] Keep generated light caches and, with -C, DAGs on disk so restarts load them (default dir: " << EpochStore::defaultDirectory() << ")" << endl
+			<< "    --dag-keep <n> Number of most recent epochs kept by --dag-dir (default: " << EpochStore::c_defaultKeep << ")" << endl
+			<< "    --shm Share light caches, and with --dag-load-mode single the host copy of the DAG, with other etcminer processes through /dev/shm (Linux only)" << endl
+			<< "    --lock-memory Lock light caches and DAGs into RAM so they are never swapped out (may need a higher ulimit -l)" << endl
+			<< "    --numa Copy light caches and, with -C, the DAG to every NUMA node and pin CPU mining threads to the nodes. Needs a copy per node" << endl
+			<< "    --lazy-dag Verify solutions against a DAG computed page by page as verification reads it, which gets faster as it fills. Uses up to a DAG of memory per cached epoch" << endl
+			<< "    --item-cache <n> Memory in MB per cached epoch for DAG items computed while verifying from the light cache, reused by later verifications (default: 0)" << endl
 			<< "    -SE, --stratum-email <s> Email address used in eth-proxy/etc-proxy (optional)" << endl
 			<< "    --farm-recheck <n>  Leave n ms between checks for changed work (default: 500). When using stratum, use a high value (i.e. 2000) to get more stable hashrate output" << endl
 			<< "    -P URL Specify a pool URL. Can be used multiple times. The 1st for for the primary pool, and the 2nd for the failover pool." << endl
@@ -790,16 +959,22 @@ public:
 			<< "    -G,--opencl  When mining use the GPU via OpenCL." << endl
 			<< "    -U,--cuda  When mining use the GPU via CUDA." << endl
 			<< "    -X,--cuda-opencl Use OpenCL + CUDA with mixed AMD/Nvidia cards. May require setting --opencl-platform 1 or 2. Use --list-devices option to check which platform is your AMD. " << endl
+#if ETH_ETHASHCPU
+			<< "    -C,--cpu [<n>]  When mining use the CPU with n threads (default: one per hardware thread)." << endl
+#endif
 			<< "    --opencl-platform <n>  When mining using -G/--opencl use OpenCL platform n (default: 0)." << endl
 			<< "    --opencl-device <n>  When mining using -G/--opencl use OpenCL device n (default: 0)." << endl
 			<< "    --opencl-devices <0 1 ..n> Select which OpenCL devices to mine on. Default is to use all" << endl
 			<< "    -t, --mining-threads <n> Limit number of CPU/GPU miners to n (default: use everything available on selected platform)" << endl
-			<< "    --list-devices List the detected OpenCL/CUDA devices and exit. Should be combined with -G, -U, or -X flag" << endl
+			<< "    --list-devices List the detected OpenCL/CUDA/CPU devices and exit. Should be combined with -G, -U, -X or -C flag" << endl
 			<< "    --display-interval <n> Set mining stats display interval in seconds. (default: every 5 seconds)" << endl			
 			<< "    -L, --dag-load-mode <mode> DAG generation mode." << endl
 			<< "        parallel    - load DAG on all GPUs at the same time (default)" << endl
 			<< "        sequential  - load DAG on GPUs one after another. Use this when the miner crashes during DAG generation" << endl
 			<< "        single <n>  - generate DAG on device n, then copy to other devices" << endl
+			<< "    --dag-parallel <n> Load the DAG on at most n GPUs at a time; each starts hashing as soon as its DAG is loaded (default: all, 1 in sequential mode)" << endl
+			<< "    --dag-host-memory <MB> Limit the host memory held by DAG loads in progress (default: no limit)" << endl
+			<< "    --verify-threads <n> Threads verifying the GPUs' solutions on the CPU (default: " << SolutionVerifier::c_defaultThreads << ")" << endl
 #if ETH_ETHASHCL
 			<< " OpenCL configuration:" << endl
 			<< "    --cl-kernel <n>  Use a different OpenCL kernel (default: use stable kernel)" << endl
@@ -852,11 +1027,16 @@ private:
 		sealers["cuda"] = Farm::SealerDescriptor{
 			&CUDAMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CUDAMiner(_farm, _index); }
 		};
+#endif
+#if ETH_ETHASHCPU
+		sealers["cpu"] = Farm::SealerDescriptor{
+			&CPUMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CPUMiner(_farm, _index); }
+		};
 #endif
 		f.setSealers(sealers);
 		f.onSolutionFound([&](Solution) { return false; });
 
-		string platformInfo = _m == MinerType::CL ? "CL" : "CUDA";
+		string platformInfo = _m == MinerType::CL ? "CL" : _m == MinerType::CPU ? "CPU" : "CUDA";
 		cout << "Benchmarking on platform: " << platformInfo << endl;
 
 		cout << "Preparing DAG for block #" << m_benchmarkBlock << endl;
@@ -866,6 +1046,8 @@ private:
 			f.start("opencl", false);
 		else if (_m == MinerType::CUDA)
 			f.start("cuda", false);
+		else if (_m == MinerType::CPU)
+			f.start("cpu", false);
 
 		WorkPackage current = WorkPackage(genesis);
 		
@@ -917,6 +1099,9 @@ private:
 #if ETH_ETHASHCUDA
 		sealers["cuda"] = Farm::SealerDescriptor{&CUDAMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CUDAMiner(_farm, _index); }};
 #endif
+#if ETH_ETHASHCPU
+		sealers["cpu"] = Farm::SealerDescriptor{&CPUMiner::instances, [](FarmFace& _farm, unsigned _index){ return new CPUMiner(_farm, _index); }};
+#endif
 
 		PoolClient *client = nullptr;
 
@@ -944,6 +1129,13 @@ private:
 		Farm f;
 		f.setSealers(sealers);
 
+		// The drivers are only queried for the display and the API, which reports power.
+		bool api = false;
+#if API_CORE
+		api = m_api_port != 0;
+#endif
+		f.setHwMonitors(m_show_hwmonitors || api, m_show_power || api);
+
 		PoolManager mgr(client, f, m_minerType);
 		mgr.setReconnectTries(m_maxFarmRetries);
 
@@ -1019,8 +1211,12 @@ private:
 	bool m_cudaNoEval = false;
 	unsigned m_parallelHash    = 4;
 #endif
+	unsigned m_cpuThreads = 0;
 	unsigned m_dagLoadMode = 0; // parallel
 	unsigned m_dagCreateDevice = 0;
+	unsigned m_dagParallel = 0;
+	uint64_t m_dagHostMemoryMB = 0;
+	unsigned m_verifyThreads = SolutionVerifier::c_defaultThreads;
 	bool m_exit = false;
 	/// Benchmarking params
 	unsigned m_benchmarkWarmup = 15;
@@ -1037,10 +1233,20 @@ private:
 	unsigned m_maxFarmRetries = 3;
 	unsigned m_farmRecheckPeriod = 500;
 	unsigned m_displayInterval = 5;
+	unsigned m_lightCacheCapacity = EthashAux::c_defaultLightCacheCapacity;
+	uint64_t m_epochPrefetchMB = EpochPrefetcher::c_defaultBudgetMB;
+	string m_dagDir;
+	unsigned m_dagKeep = EpochStore::c_defaultKeep;
+	bool m_shareEpochs = false;
+	bool m_lockMemory = false;
+	bool m_numa = false;
+	bool m_lazyDag = false;
+	uint64_t m_itemCacheMB = 0;
 	bool m_farmRecheckSet = false;
 	int m_worktimeout = 180;
 	bool m_show_hwmonitors = false;
 	bool m_show_power = false;
+	unsigned m_hwmonIntervalMs = HwMonitorSampler::c_defaultIntervalMs;
 #if API_CORE
 	int m_api_port = 0;
 #endif
@@ -108,10 +108,25 @@ void ApiServer::getMinerStatHR(const Json::Value& request, Json::Value& response
 	// total ETC hashrate in MH/s, number of ETC shares, number of ETC rejected shares.
 	response["ethhashrate"] = (p.rate());
 	response["ethhashrates"] = detailedMhEth;  
+	response["ethhashrate1m"] = p.minuteRate;	// total hashrate averaged over about a minute.
+	response["ethhashrate15m"] = p.quarterRate;	// and over about 15 minutes.
 	response["ethshares"] 	= s.getAccepts(); 
 	response["ethrejected"] = s.getRejects();   
 	response["ethinvalid"] 	= s.getFailures(); 
 	response["ethpoolsw"] 	= 0;             
+	// Verification of the GPUs' solutions on the CPU, latencies in microseconds.
+	VerifierStats v = m_farm.getVerifierStats();
+	Json::Value verification;
+	verification["verified"] = v.verified;
+	verification["failed"] = v.failed;
+	verification["dropped"] = v.dropped;
+	verification["queuedavg"] = v.avgQueuedUs();
+	verification["queuedmax"] = v.maxQueuedUs;
+	verification["verifyavg"] = v.avgVerifyUs();
+	verification["verifymax"] = v.maxVerifyUs;
+	verification["submitavg"] = v.avgSubmitUs();
+	verification["submitmax"] = v.maxSubmitUs;
+	response["verification"] = verification;
 	// Hardware Info
 	response["temperatures"] = temps;             		// Temperatures(C) for all GPUs
 	response["fanpercentages"] = fans;             		// Fans speed(%) for all GPUs
@@ -0,0 +1,196 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Memory.cpp
+ * Allocation of large buffers, backed by huge pages where possible.
+ */
+
+#include "Memory.h"
+#include <cstdint>
+#include <cstdlib>
+#include "Log.h"
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+#if defined(__linux__)
+#define DEV_HUGE_PAGES 1
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#endif
+
+using namespace std;
+using namespace dev;
+
+namespace
+{
+
+const size_t c_alignment = 64;
+const size_t c_2M = size_t(1) << 21;
+const size_t c_1G = size_t(1) << 30;
+
+size_t roundUp(size_t _x, size_t _multiple)
+{
+	return (_x + _multiple - 1) / _multiple * _multiple;
+}
+
+#if DEV_HUGE_PAGES
+
+void* mapHuge(size_t _length, int _pageShift)
+{
+	void* p = mmap(nullptr, _length, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (_pageShift << MAP_HUGE_SHIFT), -1, 0);
+	return p == MAP_FAILED ? nullptr : p;
+}
+
+/// Maps @a _length bytes at a 2 MB boundary, which transparent huge pages need.
+void* mapAligned(size_t _length)
+{
+	char* p = (char*)mmap(nullptr, _length + c_2M, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return nullptr;
+	char* aligned = (char*)roundUp((uintptr_t)p, c_2M);
+	if (aligned != p)
+		munmap(p, aligned - p);
+	munmap(aligned + _length, p + c_2M - aligned);
+	return aligned;
+}
+
+#endif
+
+}
+
+bool LargeBuffer::s_lock = false;
+
+char const* dev::toString(MemoryTier _tier)
+{
+	switch (_tier)
+	{
+	case MemoryTier::Huge1G:
+		return "1 GB huge pages";
+	case MemoryTier::Huge2M:
+		return "2 MB huge pages";
+	case MemoryTier::Transparent:
+		return "transparent huge pages";
+	default:
+		return "normal pages";
+	}
+}
+
+LargeBuffer& LargeBuffer::operator=(LargeBuffer&& _other)
+{
+	if (this != &_other)
+	{
+		reset();
+		swap(m_data, _other.m_data);
+		swap(m_size, _other.m_size);
+		swap(m_mapped, _other.m_mapped);
+		swap(m_tier, _other.m_tier);
+		swap(m_locked, _other.m_locked);
+	}
+	return *this;
+}
+
+LargeBuffer LargeBuffer::allocate(size_t _size)
+{
+	LargeBuffer ret;
+#if DEV_HUGE_PAGES
+	// 1 GB pages only when rounding up to them wastes at most an eighth.
+	size_t length = roundUp(_size, c_1G);
+	if (_size >= c_1G && length - _size <= _size / 8 && (ret.m_data = mapHuge(length, 30)))
+		ret.m_tier = MemoryTier::Huge1G;
+	else if ((ret.m_data = mapHuge(length = roundUp(_size, c_2M), 21)))
+		ret.m_tier = MemoryTier::Huge2M;
+	else if ((ret.m_data = mapAligned(length)))
+		ret.m_tier = madvise(ret.m_data, length, MADV_HUGEPAGE) == 0 ? MemoryTier::Transparent : MemoryTier::Normal;
+	else
+		return ret;
+	ret.m_mapped = length;
+#elif defined(_WIN32)
+	if (!(ret.m_data = _aligned_malloc(_size, c_alignment)))
+		return ret;
+#else
+	if (posix_memalign(&ret.m_data, c_alignment, _size) != 0)
+		return LargeBuffer();
+#endif
+	ret.m_size = _size;
+	ret.m_locked = lock(ret.m_data, _size);
+	return ret;
+}
+
+bool LargeBuffer::lock(void const* _data, size_t _size)
+{
+#if !defined(_WIN32)
+	if (s_lock)
+	{
+		if (mlock(_data, _size) == 0)
+			return true;
+		cwarn << "Can't lock" << _size << "bytes into memory; check ulimit -l.";
+	}
+#else
+	(void)_data;
+	(void)_size;
+#endif
+	return false;
+}
+
+LargeBuffer LargeBuffer::reserve(size_t _size)
+{
+	LargeBuffer ret;
+#if defined(_WIN32)
+	// Large heap blocks are fresh zeroed pages, which are only backed once written.
+	if (!(ret.m_data = _aligned_recalloc(nullptr, _size, 1, c_alignment)))
+		return ret;
+#else
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+	flags |= MAP_NORESERVE;
+#endif
+	void* p = mmap(nullptr, _size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if (p == MAP_FAILED)
+		return ret;
+#if DEV_HUGE_PAGES
+	// A transparent huge page would turn the first write to 4 KB into a 2 MB allocation.
+	madvise(p, _size, MADV_NOHUGEPAGE);
+#endif
+	ret.m_data = p;
+	ret.m_mapped = _size;
+#endif
+	ret.m_size = _size;
+	return ret;
+}
+
+void LargeBuffer::reset()
+{
+	if (m_data)
+	{
+#if defined(_WIN32)
+		_aligned_free(m_data);
+#else
+		if (m_mapped)
+			munmap(m_data, m_mapped);
+		else
+			free(m_data);
+#endif
+	}
+	m_data = nullptr;
+	m_size = m_mapped = 0;
+	m_tier = MemoryTier::Normal;
+	m_locked = false;
+}
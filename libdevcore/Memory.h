@@ -0,0 +1,88 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Memory.h
+ * Allocation of large buffers, backed by huge pages where possible.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+namespace dev
+{
+
+/// Kind of pages backing a LargeBuffer, best first.
+enum class MemoryTier
+{
+	Huge1G,			///< Explicit 1 GB huge pages.
+	Huge2M,			///< Explicit 2 MB huge pages.
+	Transparent,	///< Normal pages the kernel was asked to back with transparent huge pages.
+	Normal
+};
+
+char const* toString(MemoryTier _tier);
+
+/**
+ * @brief A large, cache line aligned buffer, freed on destruction.
+ *
+ * Light caches and DAGs are read at random 64 byte offsets, so with normal pages nearly
+ * every access misses the TLB. allocate() takes the largest pages the system offers:
+ * 1 GB huge pages if the rounding wastes little, then 2 MB huge pages, both of which the
+ * administrator has to reserve, then transparent huge pages, then normal memory.
+ */
+class LargeBuffer
+{
+public:
+	LargeBuffer() = default;
+	LargeBuffer(LargeBuffer&& _other) { *this = std::move(_other); }
+	LargeBuffer& operator=(LargeBuffer&& _other);
+	~LargeBuffer() { reset(); }
+
+	/// @returns a buffer of at least @a _size bytes, or an empty one if out of memory.
+	static LargeBuffer allocate(size_t _size);
+	/// @returns a zeroed buffer of @a _size bytes whose memory is only allocated page by
+	/// page as it is first written, or an empty one if out of address space. It uses
+	/// normal pages and is never locked.
+	static LargeBuffer reserve(size_t _size);
+
+	/// Whether new buffers are locked into RAM so they are never swapped out.
+	static void setLockMemory(bool _lock) { s_lock = _lock; }
+	/// Locks other memory holding light caches or DAGs, such as file or shared memory
+	/// mappings, into RAM if buffers are locked; unmapping it unlocks it.
+	/// @returns whether the memory was locked.
+	static bool lock(void const* _data, size_t _size);
+
+	void* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	MemoryTier tier() const { return m_tier; }
+	bool locked() const { return m_locked; }
+	explicit operator bool() const { return m_data != nullptr; }
+
+	void reset();
+
+private:
+	void* m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_mapped = 0;		///< Length of the mapping; 0 if allocated on the heap.
+	MemoryTier m_tier = MemoryTier::Normal;
+	bool m_locked = false;
+
+	static bool s_lock;
+};
+
+}
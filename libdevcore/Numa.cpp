@@ -0,0 +1,176 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Numa.cpp
+ * NUMA topology, thread placement and memory binding.
+ */
+
+#include "Numa.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#define DEV_NUMA 1
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace dev;
+
+namespace
+{
+
+struct Topology
+{
+	vector<NumaNode> nodes;
+	vector<unsigned> nodeOfCpu;		///< Index into nodes by CPU number.
+};
+
+/// Parses a kernel CPU list such as "0-7,16-23".
+vector<unsigned> parseCpuList(string const& _list)
+{
+	vector<unsigned> ret;
+	size_t pos = 0;
+	while (pos < _list.size())
+	{
+		size_t end = _list.find(',', pos);
+		if (end == string::npos)
+			end = _list.size();
+		string range = _list.substr(pos, end - pos);
+		size_t dash = range.find('-');
+		if (!range.empty() && range.find_first_not_of("0123456789-\n") == string::npos)
+		{
+			unsigned first = (unsigned)strtoul(range.c_str(), nullptr, 10);
+			unsigned last = dash == string::npos ? first : (unsigned)strtoul(range.c_str() + dash + 1, nullptr, 10);
+			for (unsigned cpu = first; cpu <= last; ++cpu)
+				ret.push_back(cpu);
+		}
+		pos = end + 1;
+	}
+	return ret;
+}
+
+Topology readTopology()
+{
+	Topology ret;
+#if DEV_NUMA
+	string const root = "/sys/devices/system/node";
+	if (DIR* d = opendir(root.c_str()))
+	{
+		while (dirent* e = readdir(d))
+		{
+			string name = e->d_name;
+			if (name.compare(0, 4, "node") != 0 || name.size() == 4 ||
+				name.find_first_not_of("0123456789", 4) != string::npos)
+				continue;
+			ifstream cpulist(root + "/" + name + "/cpulist");
+			string list;
+			getline(cpulist, list);
+			NumaNode node{(unsigned)strtoul(name.c_str() + 4, nullptr, 10), parseCpuList(list)};
+			// Memory only nodes have nothing to run a thread on.
+			if (!node.cpus.empty())
+				ret.nodes.push_back(node);
+		}
+		closedir(d);
+	}
+#endif
+	if (ret.nodes.empty())
+	{
+		NumaNode node{0, {}};
+		for (unsigned cpu = 0; cpu < max(thread::hardware_concurrency(), 1u); ++cpu)
+			node.cpus.push_back(cpu);
+		ret.nodes.push_back(node);
+	}
+	sort(ret.nodes.begin(), ret.nodes.end(), [](NumaNode const& _a, NumaNode const& _b) { return _a.id < _b.id; });
+	for (unsigned i = 0; i < ret.nodes.size(); ++i)
+		for (unsigned cpu: ret.nodes[i].cpus)
+		{
+			if (cpu >= ret.nodeOfCpu.size())
+				ret.nodeOfCpu.resize(cpu + 1, 0);
+			ret.nodeOfCpu[cpu] = i;
+		}
+	return ret;
+}
+
+Topology const& topology()
+{
+	static Topology const s_topology = readTopology();
+	return s_topology;
+}
+
+}
+
+vector<NumaNode> const& Numa::nodes()
+{
+	return topology().nodes;
+}
+
+unsigned Numa::currentNode()
+{
+#if DEV_NUMA
+	Topology const& t = topology();
+	int cpu = sched_getcpu();
+	if (t.nodes.size() > 1 && cpu >= 0 && (unsigned)cpu < t.nodeOfCpu.size())
+		return t.nodeOfCpu[cpu];
+#endif
+	return 0;
+}
+
+bool Numa::pinThread(unsigned _node)
+{
+#if DEV_NUMA
+	Topology const& t = topology();
+	if (_node >= t.nodes.size())
+		return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (unsigned cpu: t.nodes[_node].cpus)
+		if (cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	(void)_node;
+	return false;
+#endif
+}
+
+bool Numa::bindMemory(void* _data, size_t _size, unsigned _node)
+{
+#if DEV_NUMA
+	Topology const& t = topology();
+	if (_node >= t.nodes.size())
+		return false;
+	unsigned const id = t.nodes[_node].id;
+	unsigned const bitsPerLong = sizeof(unsigned long) * CHAR_BIT;
+	vector<unsigned long> mask(id / bitsPerLong + 1, 0);
+	mask[id / bitsPerLong] = 1UL << (id % bitsPerLong);
+	// The kernel ignores the last bit of the mask length it is given.
+	return syscall(SYS_mbind, _data, _size, MPOL_BIND, mask.data(), mask.size() * bitsPerLong + 1, MPOL_MF_MOVE) == 0;
+#else
+	(void)_data;
+	(void)_size;
+	(void)_node;
+	return false;
+#endif
+}
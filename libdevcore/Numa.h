@@ -0,0 +1,61 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file Numa.h
+ * NUMA topology, thread placement and memory binding.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace dev
+{
+
+/// A NUMA node with CPUs.
+struct NumaNode
+{
+	unsigned id;				///< The kernel's node number.
+	std::vector<unsigned> cpus;
+};
+
+/**
+ * @brief NUMA topology of the host, read once from /sys/devices/system/node.
+ *
+ * Nodes are referred to by their index in nodes(), which skips nodes without CPUs.
+ * Where the topology can't be read, including on other systems than Linux, there is a
+ * single node holding every CPU and the placement functions do nothing.
+ */
+class Numa
+{
+public:
+	static std::vector<NumaNode> const& nodes();
+
+	/// @returns the index of the node the calling thread currently runs on.
+	static unsigned currentNode();
+
+	/// Restricts the calling thread to the CPUs of node @a _node.
+	/// @returns false if that is not possible.
+	static bool pinThread(unsigned _node);
+
+	/// Places the pages of the @a _size bytes at @a _data on node @a _node, moving the
+	/// ones already allocated elsewhere. @a _data must be page aligned.
+	/// @returns false if that is not possible.
+	static bool bindMemory(void* _data, size_t _size, unsigned _node);
+};
+
+}
@@ -21,7 +21,6 @@
 
 #include "Worker.h"
 
-#include <chrono>
 #include <thread>
 #include "Log.h"
 using namespace std;
@@ -34,7 +33,7 @@ void Worker::startWorking()
 	if (m_work)
 	{
 		WorkerState ex = WorkerState::Stopped;
-		m_state.compare_exchange_strong(ex, WorkerState::Starting);
+		changeState([&]() { m_state.compare_exchange_strong(ex, WorkerState::Starting); });
 	}
 	else
 	{
@@ -46,9 +45,8 @@ void Worker::startWorking()
 			while (m_state != WorkerState::Killing)
 			{
 				WorkerState ex = WorkerState::Starting;
-				bool ok = m_state.compare_exchange_strong(ex, WorkerState::Started);
-//				cnote << "Trying to set Started: Thread was" << (unsigned)ex << "; " << ok;
-				(void)ok;
+				changeState([&]() { m_state.compare_exchange_strong(ex, WorkerState::Started); });
+//				cnote << "Trying to set Started: Thread was" << (unsigned)ex;
 
 				try
 				{
@@ -59,22 +57,22 @@ void Worker::startWorking()
 					clog(WarnChannel) << "Exception thrown in Worker thread: " << _e.what();
 				}
 
-//				ex = WorkerState::Stopping;
-//				m_state.compare_exchange_strong(ex, WorkerState::Stopped);
-
-				ex = m_state.exchange(WorkerState::Stopped);
-//				cnote << "State: Stopped: Thread was" << (unsigned)ex;
-				if (ex == WorkerState::Killing || ex == WorkerState::Starting)
-					m_state.exchange(ex);
+				changeState([&]()
+				{
+					ex = m_state.exchange(WorkerState::Stopped);
+//					cnote << "State: Stopped: Thread was" << (unsigned)ex;
+					if (ex == WorkerState::Killing || ex == WorkerState::Starting)
+						m_state.exchange(ex);
+				});
 
-				while (m_state == WorkerState::Stopped)
-					this_thread::sleep_for(chrono::milliseconds(20));
+				unique_lock<Mutex> s(x_state);
+				m_stateChanged.wait(s, [&]() { return m_state != WorkerState::Stopped; });
 			}
 		}));
 //		cnote << "Spawning" << m_name;
 	}
-	while (m_state == WorkerState::Starting)
-		this_thread::sleep_for(chrono::microseconds(20));
+	unique_lock<Mutex> s(x_state);
+	m_stateChanged.wait(s, [&]() { return m_state != WorkerState::Starting; });
 }
 
 void Worker::stopWorking()
@@ -83,10 +81,10 @@ void Worker::stopWorking()
 		if (m_work)
 		{
 			WorkerState ex = WorkerState::Started;
-			m_state.compare_exchange_strong(ex, WorkerState::Stopping);
+			changeState([&]() { m_state.compare_exchange_strong(ex, WorkerState::Stopping); });
 
-			while (m_state != WorkerState::Stopped)
-				this_thread::sleep_for(chrono::microseconds(20));
+			unique_lock<Mutex> s(x_state);
+			m_stateChanged.wait(s, [&]() { return m_state == WorkerState::Stopped; });
 		}
 }
 
@@ -95,8 +93,39 @@ Worker::~Worker()
 	DEV_GUARDED(x_work)
 		if (m_work)
 		{
-			m_state.exchange(WorkerState::Killing);
+			changeState([&]() { m_state.exchange(WorkerState::Killing); });
 			m_work->join();
 			m_work.reset();
 		}
 }
+
+bool Worker::waitUntil(function<bool()> const& _ready)
+{
+	unique_lock<Mutex> s(x_state);
+	m_stateChanged.wait(s, [&]() { return shouldStop() || _ready(); });
+	return _ready();
+}
+
+bool Worker::waitUntil(function<bool()> const& _ready, chrono::milliseconds _timeout)
+{
+	unique_lock<Mutex> s(x_state);
+	m_stateChanged.wait_for(s, _timeout, [&]() { return shouldStop() || _ready(); });
+	return _ready();
+}
+
+void Worker::wake()
+{
+	// Taking the lock orders the change of the condition before a waiter's check of it,
+	// or after its wait has started, so the notification isn't lost.
+	{
+		Guard l(x_state);
+	}
+	m_stateChanged.notify_all();
+}
+
+void Worker::changeState(function<void()> const& _change)
+{
+	DEV_GUARDED(x_state)
+		_change();
+	m_stateChanged.notify_all();
+}
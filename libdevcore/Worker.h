@@ -25,6 +25,9 @@
 #include <thread>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include "Guards.h"
 
 namespace dev
@@ -57,14 +60,30 @@ public:
 
 	bool shouldStop() const { return m_state != WorkerState::Started; }
 
+protected:
+	/// Blocks the worker thread until @a _ready returns true or the worker should stop.
+	/// @returns _ready().
+	bool waitUntil(std::function<bool()> const& _ready);
+	/// Same, giving up after @a _timeout.
+	bool waitUntil(std::function<bool()> const& _ready, std::chrono::milliseconds _timeout);
+
+	/// Wakes waitUntil() to check its condition again; call after making it true.
+	void wake();
+
 private:
 	virtual void workLoop() = 0;
 
+	/// Makes @a _change to m_state under x_state and wakes everyone waiting on it.
+	void changeState(std::function<void()> const& _change);
+
 	std::string m_name;
 
 	mutable Mutex x_work;						///< Lock for the network existence.
 	std::unique_ptr<std::thread> m_work;		///< The network thread.
 	std::atomic<WorkerState> m_state = {WorkerState::Starting};
+
+	Mutex x_state;								///< Taken to change m_state or a waitUntil() condition.
+	std::condition_variable m_stateChanged;
 };
 
 }
@@ -4,6 +4,7 @@
 /// @copyright GNU General Public License
 
 #include "CLMiner.h"
+#include <libethcore/EpochRegistry.h>
 #include <libethash/internal.h>
 #include "CLMiner_kernel_stable.h"
 #include "CLMiner_kernel_experimental.h"
@@ -284,19 +285,20 @@ void CLMiner::workLoop()
 	WorkPackage current;
 	current.header = h256{1u};
 	current.seed = h256{1u};
+	WorkPackagePtr currentWork;		///< The package current was copied from.
 
 	try {
 		while (!shouldStop())
 		{
-			const WorkPackage w = work();
+			WorkPackage const& w = work();
 
 			if (current.header != w.header)
 			{
 				// New work received. Update GPU data.
 				if (!w)
 				{
-					cllog << "No work. Pause for 3 s.";
-					std::this_thread::sleep_for(std::chrono::seconds(3));
+					cllog << "No work. Waiting for a work package.";
+					waitForWork();
 					continue;
 				}
 
@@ -304,15 +306,15 @@ void CLMiner::workLoop()
 
 				if (current.seed != w.seed)
 				{
-					if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
-					{
-						while (s_dagLoadIndex < index)
-							this_thread::sleep_for(chrono::seconds(1));
-						++s_dagLoadIndex;
-					}
+					// The load holds the light cache while uploading it.
+					EpochInfo const* epoch = EpochRegistry::get().bySeed(w.seed);
+					DagLoadScheduler::Ticket ticket = admitDagLoad(epoch ? epoch->cacheSize : 0);
+					if (!ticket)
+						break;
 
 					cllog << "New seed" << w.seed;
 					init(w.seed);
+					++s_dagLoadIndex;
 				}
 
 				// Upper 64 bits of the boundary.
@@ -358,19 +360,12 @@ void CLMiner::workLoop()
 			m_searchKernel.setArg(3, startNonce);
 			m_queue.enqueueNDRangeKernel(m_searchKernel, cl::NullRange, m_globalWorkSize, m_workgroupSize);
 
-			// Report results while the kernel is running.
-			// It takes some time because ethash must be re-evaluated on CPU.
-			if (nonce != 0) {
-				Result r = EthashAux::eval(current.seed, current.header, nonce);
-				if (r.value < current.boundary)
-					farm.submitProof(Solution{nonce, r.mixHash, current, current.header != w.header});
-				else {
-					farm.failedSolution();
-					cwarn << "FAILURE: GPU gave incorrect result!";
-				}
-			}
+			// Ethash is re-evaluated on the CPU by the farm's verifier threads.
+			if (nonce != 0)
+				verifySolution(nonce, currentWork, current.header != w.header);
 
 			current = w;        // kernel now processing newest work
+			currentWork = workPtr();
 			current.startNonce = startNonce;
 			// Increase start nonce for following kernel execution.
 			startNonce += m_globalWorkSize;
@@ -392,7 +387,11 @@ void CLMiner::workLoop()
 	}
 }
 
-void CLMiner::kick_miner() {}
+void CLMiner::kick_miner()
+{
+	// Nothing to give up: the work loop checks for new work between kernel runs, and a
+	// running kernel can't be interrupted.
+}
 
 unsigned CLMiner::getNumDevices()
 {
@@ -469,7 +468,7 @@ bool CLMiner::configureGPU(
 	s_workgroupSize = _localWorkSize;
 	s_initialGlobalWorkSize = _globalWorkSizeMultiplier * _localWorkSize;
 
-	uint64_t dagSize = ethash_get_datasize(_currentBlock);
+	uint64_t dagSize = EpochRegistry::get().byBlock(_currentBlock).dagSize;
 
 	vector<cl::Platform> platforms = getPlatforms();
 	if (platforms.empty())
@@ -596,7 +595,7 @@ bool CLMiner::init(const h256& seed)
 		if (m_globalWorkSize % m_workgroupSize != 0)
 			m_globalWorkSize = ((m_globalWorkSize / m_workgroupSize) + 1) * m_workgroupSize;
 
-		uint64_t dagSize = ethash_get_datasize(light->light->block_number);
+		uint64_t dagSize = EpochRegistry::get().byBlock(light->light->block_number).dagSize;
 		uint32_t dagSize128 = (unsigned)(dagSize / ETHASH_MIX_BYTES);
 		uint32_t lightSize64 = (unsigned)(light->data().size() / sizeof(node));
 
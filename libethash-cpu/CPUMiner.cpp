@@ -0,0 +1,219 @@
+/// CPU miner implementation.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#include "CPUMiner.h"
+#include <libdevcore/Numa.h>
+#include <libethcore/EpochRegistry.h>
+#include <libethash/sha3.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+namespace dev
+{
+namespace eth
+{
+
+unsigned CPUMiner::s_numInstances = 0;
+
+struct CPUChannel: public LogChannel
+{
+	static const char* name() { return EthOrange " cp"; }
+	static const int verbosity = 2;
+	static const bool debug = false;
+};
+struct CPUSwitchChannel: public LogChannel
+{
+	static const char* name() { return EthOrange " cp"; }
+	static const int verbosity = 6;
+	static const bool debug = false;
+};
+#define cpulog clog(CPUChannel)
+#define cpuswitchlog clog(CPUSwitchChannel)
+
+}
+}
+
+CPUMiner::CPUMiner(FarmFace& _farm, unsigned _index):
+	Miner("cpu-", _farm, _index)
+{}
+
+CPUMiner::~CPUMiner()
+{
+	stopWorking();
+	kick_miner();
+}
+
+bool CPUMiner::init(const h256& seed)
+{
+	try
+	{
+		// Drop our reference to the previous epoch before the new DAG is allocated.
+		m_dag.reset();
+
+		// The DAG is shared by all CPU miners: the first one to get here generates it
+		// with all hardware threads, the others wait for it.
+		auto startDAG = std::chrono::steady_clock::now();
+		unsigned lastReported = 0;
+		m_dag = EthashAux::full(seed, true, [&](unsigned _percent)
+		{
+			if (_percent >= lastReported + 10)
+			{
+				lastReported = _percent - _percent % 10;
+				cpulog << "Generating DAG: " << lastReported << "%";
+			}
+			return !shouldStop();
+		});
+		if (m_dag)
+		{
+			auto dagTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startDAG);
+			float gb = (float)m_dag->size / (1024 * 1024 * 1024);
+			cnote << gb << " GB of DAG data ready in" << dagTime.count() << "ms.";
+		}
+		return !shouldStop();
+	}
+	catch (std::exception const& _e)
+	{
+		cwarn << "Error CPU mining: " << _e.what();
+		if (s_exit)
+			exit(1);
+		return false;
+	}
+}
+
+void CPUMiner::workLoop()
+{
+	WorkPackage current;
+	current.header = h256{1u};
+	current.seed = h256{1u};
+
+	// Spread the threads over the NUMA nodes so each one hashes against its local copy of the DAG.
+	if (EthashAux::numaCopies() > 1)
+	{
+		unsigned node = index % EthashAux::numaCopies();
+		if (Numa::pinThread(node))
+			cpulog << "Pinned to NUMA node " << Numa::nodes()[node].id;
+	}
+
+	while (!shouldStop())
+	{
+		// The package stays valid until the next call to work(), however many are published.
+		WorkPackage const& w = work();
+
+		if (current.header != w.header || current.seed != w.seed)
+		{
+			if (!w)
+			{
+				cpulog << "No work. Waiting for a work package.";
+				waitForWork();
+				continue;
+			}
+			if (current.seed != w.seed)
+			{
+				if (!init(w.seed))
+					break;
+				// Generation was cancelled for a newer epoch; pick up the new work package.
+				if (!m_dag)
+					continue;
+			}
+			current = w;
+
+			if (current.exSizeBits >= 0)
+			{
+				// This can support up to 2^c_log2MaxMiners devices.
+				m_nonce = current.startNonce | ((uint64_t)index << (64 - LOG2_MAX_MINERS - current.exSizeBits));
+			}
+			else
+				m_nonce = get_start_nonce();
+		}
+		search(current);
+	}
+}
+
+void CPUMiner::search(WorkPackage const& w)
+{
+	ethash_h256_t const header = *reinterpret_cast<ethash_h256_t const*>(w.header.data());
+	node const* nodes = (node const*)ethash_full_dag(m_dag->local());
+	uint64_t const size = m_dag->size;
+	ethash_search_t job;
+	ethash_search_init(&job, nodes, size, &header, (uint64_t)(u64)((u256)w.boundary >> 192));
+
+	while (true)
+	{
+		// Candidates only meet the upper 64 bits of the boundary; check the whole of it.
+		uint64_t found[c_defaultBatchSize];
+		unsigned const count = ethash_search_run(&job, m_nonce, c_defaultBatchSize, found, c_defaultBatchSize);
+		for (unsigned i = 0; i != count; ++i)
+		{
+			ethash_return_value_t r = ethash_full_compute_internal(nodes, size, header, found[i]);
+			if (h256(r.result.b, h256::ConstructFromPointer) < w.boundary)
+				farm.submitProof(Solution{found[i], h256(r.mix_hash.b, h256::ConstructFromPointer), w, m_new_work});
+		}
+		m_nonce += c_defaultBatchSize;
+		addHashCount(c_defaultBatchSize);
+
+		bool t = true;
+		if (m_new_work.compare_exchange_strong(t, false))
+		{
+			cpuswitchlog << "Switch time "
+				<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - workSwitchStart).count()
+				<< "ms.";
+			break;
+		}
+		if (shouldStop())
+		{
+			m_new_work.store(false, std::memory_order_relaxed);
+			break;
+		}
+	}
+}
+
+void CPUMiner::kick_miner()
+{
+	m_new_work.store(true, std::memory_order_relaxed);
+}
+
+unsigned CPUMiner::getNumDevices()
+{
+	unsigned threads = std::thread::hardware_concurrency();
+	return threads > 0 ? threads : 1;
+}
+
+void CPUMiner::listDevices()
+{
+	cout << "\nListing CPU devices.\nFORMAT: [deviceID] deviceName\n";
+	cout << "[0] CPU\n";
+	cout << "\tHardware threads: " << getNumDevices() << "\n";
+}
+
+void CPUMiner::setNumInstances(unsigned _instances)
+{
+	s_numInstances = std::min<unsigned>(std::min<unsigned>(_instances, getNumDevices()), MAX_MINERS);
+}
+
+bool CPUMiner::configureCPU(uint64_t _currentBlock, bool _exit)
+{
+	s_exit = _exit;
+
+	uint64_t dagSize = EpochRegistry::get().byBlock(_currentBlock).dagSize * EthashAux::numaCopies();
+#if defined(__linux__) || defined(__APPLE__)
+	uint64_t memory = (uint64_t)sysconf(_SC_PHYS_PAGES) * (uint64_t)sysconf(_SC_PAGESIZE);
+	if (memory < dagSize)
+	{
+		cout << "Host has insufficient memory for the DAG. " << memory << " bytes of memory found < "
+			 << dagSize << " bytes of memory required. Can't CPU mine. Remove the -C argument" << endl;
+		return false;
+	}
+#endif
+	cpulog << "Using " << instances() << " CPU mining threads, " << ethash_search_lanes() << " nonces per register, "
+		<< sha3_lanes() << " Keccak lanes, " << ethash_fnv_kernel() << " FNV kernels, " << EthashAux::numaCopies()
+		<< " copies of the DAG";
+	return true;
+}
@@ -0,0 +1,53 @@
+/// CPU miner implementation.
+///
+/// @file
+/// @copyright GNU General Public License
+
+#pragma once
+
+#include <libdevcore/Worker.h>
+#include <libethcore/EthashAux.h>
+#include <libethcore/Miner.h>
+#include <libethash/internal.h>
+
+namespace dev
+{
+namespace eth
+{
+
+class CPUMiner: public Miner
+{
+public:
+	/* -- default values -- */
+	/// Number of nonces hashed between two checks for new work.
+	static const unsigned c_defaultBatchSize = 256;
+
+	CPUMiner(FarmFace& _farm, unsigned _index);
+	~CPUMiner() override;
+
+	static unsigned instances() { return s_numInstances > 0 ? s_numInstances : 1; }
+	static unsigned getNumDevices();
+	static void listDevices();
+	static bool configureCPU(uint64_t _currentBlock, bool _exit);
+	static void setNumInstances(unsigned _instances);
+
+protected:
+	void kick_miner() override;
+
+private:
+	void workLoop() override;
+
+	bool init(const h256& seed);
+
+	void search(WorkPackage const& w);
+
+	atomic<bool> m_new_work = {false};
+
+	EthashAux::FullType m_dag;
+	uint64_t m_nonce = 0;
+
+	static unsigned s_numInstances;
+};
+
+}
+}
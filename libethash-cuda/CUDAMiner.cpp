@@ -19,6 +19,7 @@ along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 #undef max
 
 #include "CUDAMiner.h"
+#include <libethcore/EpochRegistry.h>
 
 using namespace std;
 using namespace dev;
@@ -58,30 +59,55 @@ CUDAMiner::~CUDAMiner()
 bool CUDAMiner::init(const h256& seed)
 {
 	try {
-		if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
-			while (s_dagLoadIndex < index)
-				this_thread::sleep_for(chrono::milliseconds(100));
 		unsigned device = s_devices[index] > -1 ? s_devices[index] : index;
-
-		cnote << "Initialising miner " << index;
+		bool const single = s_dagLoadMode == DAG_LOAD_MODE_SINGLE;
 
 		EthashAux::LightType light;
 		light = EthashAux::light(seed);
 		bytesConstRef lightData = light->data();
+		uint64_t const dagSize = EpochRegistry::get().byBlock(light->light->block_number).dagSize;
+
+		// In single mode the other devices upload the host copy of the creating device's
+		// DAG. They wait for this epoch's copy before asking to load, so they don't hold up
+		// the creator, and keep it alive until they have uploaded it.
+		bool const hostCopy = single && !EpochShare::enabled();
+		shared_ptr<LargeBuffer> hostDag;
+		if (hostCopy && device != s_dagCreateDevice && !DagLoadScheduler::get().waitFor([&]()
+			{
+				if (!s_dagHostBuffer || s_dagHostSeed != seed)
+					return false;
+				hostDag = s_dagHostBuffer;
+				return true;
+			}, [this]() { return shouldStop(); }))
+			return false;
+		uint8_t* hostDagData = hostDag ? (uint8_t*)hostDag->data() : nullptr;
+		// The load holds the light cache, and the creating device a host copy of the DAG.
+		uint64_t hostBytes = lightData.size() + (single && device == s_dagCreateDevice ? dagSize : 0);
+		DagLoadScheduler::Ticket ticket = admitDagLoad(hostBytes);
+		if (!ticket)
+			return false;
+
+		cnote << "Initialising miner " << index;
 
 		cuda_init(getNumDevices(), light->light, lightData.data(), lightData.size(), 
-			device, (s_dagLoadMode == DAG_LOAD_MODE_SINGLE), s_dagInHostMemory, s_dagCreateDevice);
-		s_dagLoadIndex++;
-    
-		if (s_dagLoadMode == DAG_LOAD_MODE_SINGLE)
+			device, single, hostDagData, s_dagCreateDevice);
+		ticket.release();
+
+		if (hostCopy)
 		{
-			if (s_dagLoadIndex >= s_numInstances && s_dagInHostMemory)
+			// s_dagLoadIndex counts the devices done with this epoch's host copy. Once all
+			// have loaded their DAG it is freed, by whichever device lets go of it last.
+			bool freed = false;
+			DagLoadScheduler::get().notify([&]()
 			{
-				// all devices have loaded DAG, we can free now
-				delete[] s_dagInHostMemory;
-				s_dagInHostMemory = NULL;
+				if (s_dagHostBuffer && s_dagHostSeed == seed && ++s_dagLoadIndex >= s_numInstances)
+				{
+					s_dagHostBuffer.reset();
+					freed = true;
+				}
+			});
+			if (freed)
 				cnote << "Freeing DAG from host";
-			}
 		}
 		return true;
 	}
@@ -104,15 +130,15 @@ void CUDAMiner::workLoop()
 	{
 		while(!shouldStop())
 		{
-	                // take local copy of work since it may end up being overwritten.
-			const WorkPackage w = work();
+			// The package stays valid until the next call to work(), however many are published.
+			WorkPackage const& w = work();
 			
 			if (current.header != w.header || current.seed != w.seed)
 			{
 				if(!w || w.header == h256())
 				{
-					cnote << "No work. Pause for 3 s.";
-					std::this_thread::sleep_for(std::chrono::seconds(3));
+					cnote << "No work. Waiting for a work package.";
+					waitForWork();
 					continue;
 				}
 				if (current.seed != w.seed)
@@ -272,7 +298,7 @@ bool CUDAMiner::cuda_configureGPU(
 		cudalog << "Using grid size " << s_gridSize << ", block size " << s_blockSize;
 
 		// by default let's only consider the DAG of the first epoch
-		uint64_t dagSize = ethash_get_datasize(_currentBlock);
+		uint64_t dagSize = EpochRegistry::get().byBlock(_currentBlock).dagSize;
 		int devicesCount = static_cast<int>(numDevices);
 		for (int i = 0; i < devicesCount; i++)
 		{
@@ -308,6 +334,8 @@ unsigned CUDAMiner::s_gridSize = CUDAMiner::c_defaultGridSize;
 unsigned CUDAMiner::s_numStreams = CUDAMiner::c_defaultNumStreams;
 unsigned CUDAMiner::s_scheduleFlag = 0;
 bool CUDAMiner::s_noeval = false;
+shared_ptr<LargeBuffer> CUDAMiner::s_dagHostBuffer;
+h256 CUDAMiner::s_dagHostSeed;
 
 bool CUDAMiner::cuda_init(
 	size_t numDevices,
@@ -338,7 +366,8 @@ bool CUDAMiner::cuda_init(
 		m_search_buf = new volatile search_results *[s_numStreams];
 		m_streams = new cudaStream_t[s_numStreams];
 
-		uint64_t dagSize = ethash_get_datasize(_light->block_number);
+		EpochInfo const& epoch = EpochRegistry::get().byBlock(_light->block_number);
+		uint64_t dagSize = epoch.dagSize;
 		uint32_t dagSize128   = (unsigned)(dagSize / ETHASH_MIX_BYTES);
 		uint32_t lightSize64 = (unsigned)(_lightSize / sizeof(node));
 
@@ -396,7 +425,35 @@ bool CUDAMiner::cuda_init(
 			m_current_nonce = 0;
 			m_current_index = 0;
 
-			if (!hostDAG)
+			if (_cpyToHost && EpochShare::enabled())
+			{
+				// Whichever process gets here first generates the DAG and shares it
+				// through host memory; all others upload that copy.
+				bool generated = false;
+				m_sharedDag.reset();
+				m_sharedDag = EpochShare::acquire(EpochShare::Kind::HostDag, epoch, dagSize, [&](void* _host)
+				{
+					cudalog << "Generating DAG for GPU #" << m_device_num << " with dagSize: "
+							<< dagSize <<" gridSize: " << s_gridSize;
+					ethash_generate_dag(dagSize, s_gridSize, s_blockSize, m_streams[0], m_device_num);
+					cudalog << "Copying DAG from GPU #" << m_device_num << " to shared host memory";
+					CUDA_SAFE_CALL(cudaMemcpy(_host, reinterpret_cast<void*>(dag), dagSize, cudaMemcpyDeviceToHost));
+					generated = true;
+					return true;
+				});
+				if (!m_sharedDag)
+				{
+					cudalog << "Generating DAG for GPU #" << m_device_num << " with dagSize: "
+							<< dagSize <<" gridSize: " << s_gridSize;
+					ethash_generate_dag(dagSize, s_gridSize, s_blockSize, m_streams[0], m_device_num);
+				}
+				else if (!generated)
+				{
+					cudalog << "Copying shared DAG from host to GPU #" << m_device_num;
+					CUDA_SAFE_CALL(cudaMemcpy(reinterpret_cast<void*>(dag), m_sharedDag.data(), dagSize, cudaMemcpyHostToDevice));
+				}
+			}
+			else if (!hostDAG)
 			{
 				if((m_device_num == dagCreateDevice) || !_cpyToHost){ //if !cpyToHost -> All devices shall generate their DAG
 					cudalog << "Generating DAG for GPU #" << m_device_num << " with dagSize: " 
@@ -405,15 +462,24 @@ bool CUDAMiner::cuda_init(
 
 					if (_cpyToHost)
 					{
-						uint8_t* memoryDAG = new uint8_t[dagSize];
+						auto buffer = make_shared<LargeBuffer>(LargeBuffer::allocate(dagSize));
+						if (!*buffer)
+							throw std::runtime_error{"Out of host memory for the DAG copy"};
 						cudalog << "Copying DAG from GPU #" << m_device_num << " to host";
-						CUDA_SAFE_CALL(cudaMemcpy(reinterpret_cast<void*>(memoryDAG), dag, dagSize, cudaMemcpyDeviceToHost));
+						CUDA_SAFE_CALL(cudaMemcpy(buffer->data(), dag, dagSize, cudaMemcpyDeviceToHost));
 
-						hostDAG = memoryDAG;
+						// Replaces the previous epoch's copy, which devices still uploading it
+						// hold on to, and starts counting the devices done with this one.
+						DagLoadScheduler::get().notify([&]()
+						{
+							s_dagHostBuffer = buffer;
+							s_dagHostSeed = epoch.seed;
+							s_dagLoadIndex = 0;
+						});
 					}
 				}else{
-					while(!hostDAG)
-						this_thread::sleep_for(chrono::milliseconds(100)); 
+					if (!DagLoadScheduler::get().waitFor([&]() { return hostDAG != nullptr; }, [this]() { return shouldStop(); }))
+						return false;
 					goto cpyDag;
 				}
 			}
@@ -517,20 +583,15 @@ void CUDAMiner::search(
 		if (m_current_index >= s_numStreams)
 		{
 			if (found_count)
-				for (uint32_t i = 0; i < found_count; i++)
-					if (s_noeval)
+			{
+				if (s_noeval)
+					for (uint32_t i = 0; i < found_count; i++)
 						farm.submitProof(Solution{nonces[i], mixes[i], w, m_new_work});
-					else
-					{
-						Result r = EthashAux::eval(w.seed, w.header, nonces[i]);
-						if (r.value < w.boundary)
-							farm.submitProof(Solution{nonces[i], r.mixHash, w, m_new_work});
-						else
-						{
-							farm.failedSolution();
-							cwarn << "GPU gave incorrect result!";
-						}
-					}
+				else
+					// The farm's verifier threads verify a burst of results together.
+					for (uint32_t i = 0; i < found_count; i++)
+						verifySolution(nonces[i], workPtr(), m_new_work);
+			}
 
 			addHashCount(batch_size);
 			bool t = true;
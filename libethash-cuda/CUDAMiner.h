@@ -118,6 +118,9 @@ private:
 	uint32_t m_dag_size = -1;
 	uint32_t m_device_num;
 
+	/// Host copy of the DAG shared with other processes, held until the next epoch.
+	EpochShare::Segment m_sharedDag;
+
 	volatile search_results** m_search_buf;
 	cudaStream_t  * m_streams;
 
@@ -135,6 +138,11 @@ private:
 	static unsigned s_numInstances;
 	static vector<int> s_devices;
 
+	/// Host copy of the DAG in single load mode and the seed of its epoch, published by
+	/// the creating device for the others to upload. Guarded by the DagLoadScheduler.
+	static std::shared_ptr<LargeBuffer> s_dagHostBuffer;
+	static h256 s_dagHostSeed;
+
 	static bool s_noeval;
 
 };
@@ -31,3 +31,57 @@
 #define restrict __restrict__
 #endif
 
+// hint that the cache line at addr is about to be read
+#if defined(__GNUC__)
+#define ethash_prefetch(addr) __builtin_prefetch((addr))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define ethash_prefetch(addr) _mm_prefetch((char const*)(addr), _MM_HINT_T0)
+#else
+#define ethash_prefetch(addr)
+#endif
+
+
+// atomic operations on 32 bit words shared between threads, and 64 bit counters
+#if defined(__GNUC__)
+#define ethash_load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ethash_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define ethash_cas(p, expected, desired) __sync_bool_compare_and_swap((p), (expected), (desired))
+#define ethash_fetch_add(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define ethash_fence_acquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define ethash_load_counter(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define ethash_count(p) __atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+// volatile accesses have acquire and release semantics with /volatile:ms, the default on x86
+#define ethash_load_acquire(p) (*(uint32_t volatile*)(p))
+#define ethash_store_release(p, v) (*(uint32_t volatile*)(p) = (v))
+#define ethash_cas(p, expected, desired) \
+	(_InterlockedCompareExchange((long volatile*)(p), (long)(desired), (long)(expected)) == (long)(expected))
+#define ethash_fetch_add(p, v) _InterlockedExchangeAdd((long volatile*)(p), (long)(v))
+#define ethash_fence_acquire() _ReadWriteBarrier()
+#define ethash_load_counter(p) (*(uint64_t volatile*)(p))
+#define ethash_count(p) _InterlockedIncrement64((__int64 volatile*)(p))
+#endif
+
+// Runs init() once, on the first call from any thread, and returns its result to every
+// call; callers racing the first one wait for it. *once must start at 0, and init()
+// must return neither 0 nor UINT32_MAX, which mark a result not yet known.
+#if defined(__GNUC__) || defined(_MSC_VER)
+#include <stdint.h>
+static inline uint32_t ethash_once(uint32_t* once, uint32_t (*init)(void))
+{
+	uint32_t ret = ethash_load_acquire(once);
+	if (ret != 0 && ret != UINT32_MAX) {
+		return ret;
+	}
+	if (ethash_cas(once, 0, UINT32_MAX)) {
+		ret = init();
+		ethash_store_release(once, ret);
+		return ret;
+	}
+	while ((ret = ethash_load_acquire(once)) == UINT32_MAX) {
+	}
+	return ret;
+}
+#endif
@@ -49,6 +49,11 @@ typedef struct ethash_h256 { uint8_t b[32]; } ethash_h256_t;
 
 struct ethash_light;
 typedef struct ethash_light* ethash_light_t;
+struct ethash_full;
+typedef struct ethash_full* ethash_full_t;
+struct ethash_lazy;
+typedef struct ethash_lazy* ethash_lazy_t;
+typedef int(*ethash_callback_t)(unsigned);
 
 typedef struct ethash_return_value {
 	ethash_h256_t result;
@@ -82,6 +87,64 @@ ethash_return_value_t ethash_light_compute(
 	ethash_h256_t const header_hash,
 	uint64_t nonce
 );
+/**
+ * Calculate the light client data for several (header, nonce) pairs at once.
+ * Faster than calling @ref ethash_light_compute for each pair as the cache reads
+ * of the pairs overlap.
+ *
+ * @param light          The light client handler
+ * @param header_hashes  The header hash of each pair
+ * @param nonces         The nonce of each pair
+ * @param count          The number of pairs
+ * @param ret            Array receiving the @a count return values
+ */
+void ethash_light_compute_batch(
+	ethash_light_t light,
+	ethash_h256_t const* header_hashes,
+	uint64_t const* nonces,
+	unsigned count,
+	ethash_return_value_t* ret
+);
+
+/**
+ * Allocate and initialize a new ethash_full handler
+ *
+ * @param light         The light handler containing the cache.
+ * @param callback      A callback function with signature of @ref ethash_callback_t
+ *                      It accepts an unsigned with which a progress of DAG calculation
+ *                      can be displayed. If all goes well the callback should return 0.
+ *                      If a non-zero value is returned then DAG generation will stop.
+ *                      May be NULL.
+ * @return              Newly allocated ethash_full handler or NULL in case of
+ *                      ERRNOMEM or an aborted DAG generation
+ */
+ethash_full_t ethash_full_new(ethash_light_t light, ethash_callback_t callback);
+/**
+ * Frees a previously allocated ethash_full handler
+ * @param full    The full handler to free
+ */
+void ethash_full_delete(ethash_full_t full);
+/**
+ * Calculate the full client data
+ *
+ * @param full           The full client handler
+ * @param header_hash    The header hash to pack into the mix
+ * @param nonce          The nonce to pack into the mix
+ * @return               An object of ethash_return_value_t holding the return values
+ */
+ethash_return_value_t ethash_full_compute(
+	ethash_full_t full,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+);
+/**
+ * Get a pointer to the full DAG data
+ */
+void const* ethash_full_dag(ethash_full_t full);
+/**
+ * Get the size of the DAG data
+ */
+uint64_t ethash_full_dag_size(ethash_full_t full);
 
 /**
  * Calculate the seedhash for a given block number
@@ -0,0 +1,68 @@
+/*
+  This file is part of ethash.
+
+  ethash is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ethash is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ethash.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file fastmod.h
+ * Remainder by a runtime constant without a division instruction.
+ */
+
+#pragma once
+#include <stdint.h>
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A 32 bit divisor with its precomputed reciprocal. x % d is then two multiplications
+// instead of a division, which takes tens of cycles on the hashes' dependency chains.
+// Exact for every 32 bit x and d > 0 (Lemire, Kaser and Kurz, "Faster Remainder by
+// Direct Computation", 2019).
+typedef struct ethash_divisor {
+	uint64_t reciprocal;	// 2^64 / d, rounded up
+	uint32_t d;
+} ethash_divisor_t;
+
+static inline ethash_divisor_t ethash_divisor(uint32_t d)
+{
+	ethash_divisor_t ret;
+	ret.reciprocal = UINT64_MAX / d + 1;
+	ret.d = d;
+	return ret;
+}
+
+// x % d computed from 32 bit halves, for compilers without a 128 bit type.
+static inline uint32_t ethash_mod_portable(uint32_t x, ethash_divisor_t const div)
+{
+	uint64_t const fraction = div.reciprocal * x;
+	return (uint32_t)((((fraction & 0xffffffff) * div.d >> 32) + (fraction >> 32) * div.d) >> 32);
+}
+
+static inline uint32_t ethash_mod(uint32_t x, ethash_divisor_t const div)
+{
+#if defined(__SIZEOF_INT128__)
+	// the fractional part of x / d in 64 bit fixed point; times d, its integer part is x % d
+	uint64_t const fraction = div.reciprocal * x;
+	// __extension__ keeps -pedantic C++ units including this quiet about __int128.
+	__extension__ typedef unsigned __int128 ethash_u128;
+	return (uint32_t)(((ethash_u128)fraction * div.d) >> 64);
+#else
+	return ethash_mod_portable(x, div);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,278 @@
+/*
+  This file is part of ethash.
+
+  ethash is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ethash is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cpp-ethereum.	If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file fnv_kernels.c
+* SIMD implementations of the FNV mixing loops, selected at runtime.
+*
+* Each kernel set is checked against the scalar code when it is selected
+* and is only used if both agree bit for bit.
+*/
+
+#include <string.h>
+#include "fnv.h"
+#include "internal.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FNV_X86 1
+#define FNV_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define FNV_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define FNV_X86 1
+#define FNV_TARGET_SSE41
+#define FNV_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#elif defined(__aarch64__)
+#define FNV_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The target of kernels built for the baseline instruction set.
+#define FNV_TARGET_DEFAULT
+
+// Defines the kernel set's DAG item function, which applies @a fnv_node to each item
+// and its parents. Every item's parent is looked up and prefetched first so that the
+// loads overlap.
+#define FNV_DAG_PARENTS(name, target, fnv_node) \
+static target void name(node* items, uint32_t const* indices, uint32_t n, node const* cache_nodes, ethash_divisor_t num_parent_nodes) \
+{ \
+	node const* parents[ETHASH_DAG_BATCH]; \
+	for (uint32_t i = 0; i != ETHASH_DATASET_PARENTS; ++i) { \
+		for (uint32_t k = 0; k != n; ++k) { \
+			parents[k] = &cache_nodes[ethash_mod(fnv_hash(indices[k] ^ i, items[k].words[i % NODE_WORDS]), num_parent_nodes)]; \
+			ethash_prefetch(parents[k]); \
+		} \
+		for (uint32_t k = 0; k != n; ++k) { \
+			fnv_node(items[k].words, parents[k]->words); \
+		} \
+	} \
+}
+
+typedef void (*fnv_mix_fn)(uint32_t* restrict mix, uint32_t const* restrict data, unsigned words);
+typedef void (*dag_parents_fn)(node* items, uint32_t const* indices, uint32_t n, node const* cache_nodes, ethash_divisor_t num_parent_nodes);
+
+struct fnv_kernels {
+	char const* name;
+	fnv_mix_fn mix;
+	dag_parents_fn dag_parents;
+};
+
+/******** Scalar ********/
+
+static void fnv_mix_scalar(uint32_t* restrict mix, uint32_t const* restrict data, unsigned words)
+{
+	for (unsigned w = 0; w != words; ++w) {
+		mix[w] = fnv_hash(mix[w], data[w]);
+	}
+}
+
+static inline void fnv_node_scalar(uint32_t* mix, uint32_t const* data)
+{
+	fnv_mix_scalar(mix, data, NODE_WORDS);
+}
+
+FNV_DAG_PARENTS(dag_parents_scalar, FNV_TARGET_DEFAULT, fnv_node_scalar)
+
+static struct fnv_kernels const fnv_kernels_scalar = {"scalar", fnv_mix_scalar, dag_parents_scalar};
+
+/******** SSE4.1 and AVX2 ********/
+
+#if defined(FNV_X86)
+
+static FNV_TARGET_SSE41 inline void fnv_node_sse41(uint32_t* mix, uint32_t const* data)
+{
+	__m128i const prime = _mm_set1_epi32(FNV_PRIME);
+	for (unsigned w = 0; w != NODE_WORDS; w += 4) {
+		__m128i m = _mm_loadu_si128((__m128i const*)(mix + w));
+		__m128i d = _mm_loadu_si128((__m128i const*)(data + w));
+		_mm_storeu_si128((__m128i*)(mix + w), _mm_xor_si128(_mm_mullo_epi32(m, prime), d));
+	}
+}
+
+static FNV_TARGET_SSE41 void fnv_mix_sse41(uint32_t* restrict mix, uint32_t const* restrict data, unsigned words)
+{
+	for (unsigned w = 0; w != words; w += NODE_WORDS) {
+		fnv_node_sse41(mix + w, data + w);
+	}
+}
+
+FNV_DAG_PARENTS(dag_parents_sse41, FNV_TARGET_SSE41, fnv_node_sse41)
+
+static FNV_TARGET_AVX2 inline void fnv_node_avx2(uint32_t* mix, uint32_t const* data)
+{
+	__m256i const prime = _mm256_set1_epi32(FNV_PRIME);
+	__m256i m0 = _mm256_loadu_si256((__m256i const*)mix);
+	__m256i m1 = _mm256_loadu_si256((__m256i const*)(mix + 8));
+	m0 = _mm256_xor_si256(_mm256_mullo_epi32(m0, prime), _mm256_loadu_si256((__m256i const*)data));
+	m1 = _mm256_xor_si256(_mm256_mullo_epi32(m1, prime), _mm256_loadu_si256((__m256i const*)(data + 8)));
+	_mm256_storeu_si256((__m256i*)mix, m0);
+	_mm256_storeu_si256((__m256i*)(mix + 8), m1);
+}
+
+static FNV_TARGET_AVX2 void fnv_mix_avx2(uint32_t* restrict mix, uint32_t const* restrict data, unsigned words)
+{
+	for (unsigned w = 0; w != words; w += NODE_WORDS) {
+		fnv_node_avx2(mix + w, data + w);
+	}
+}
+
+FNV_DAG_PARENTS(dag_parents_avx2, FNV_TARGET_AVX2, fnv_node_avx2)
+
+static struct fnv_kernels const fnv_kernels_sse41 = {"sse4.1", fnv_mix_sse41, dag_parents_sse41};
+static struct fnv_kernels const fnv_kernels_avx2 = {"avx2", fnv_mix_avx2, dag_parents_avx2};
+
+#if defined(_MSC_VER)
+static int fnv_cpu_has_sse41(void)
+{
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 19)) != 0;
+}
+
+static int fnv_cpu_has_avx2(void)
+{
+	int info[4];
+	__cpuid(info, 1);
+	// AVX support by the CPU (bit 28) and the OS saving ymm state (OSXSAVE, XCR0)
+	if (!(info[2] & (1 << 28)) || !(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) {
+		return 0;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+}
+#else
+static int fnv_cpu_has_sse41(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.1");
+}
+
+static int fnv_cpu_has_avx2(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#endif
+
+/******** NEON ********/
+
+#if defined(FNV_NEON)
+
+static inline void fnv_node_neon(uint32_t* mix, uint32_t const* data)
+{
+	uint32x4_t const prime = vdupq_n_u32(FNV_PRIME);
+	for (unsigned w = 0; w != NODE_WORDS; w += 4) {
+		uint32x4_t m = vld1q_u32(mix + w);
+		vst1q_u32(mix + w, veorq_u32(vmulq_u32(m, prime), vld1q_u32(data + w)));
+	}
+}
+
+static void fnv_mix_neon(uint32_t* restrict mix, uint32_t const* restrict data, unsigned words)
+{
+	for (unsigned w = 0; w != words; w += NODE_WORDS) {
+		fnv_node_neon(mix + w, data + w);
+	}
+}
+
+FNV_DAG_PARENTS(dag_parents_neon, FNV_TARGET_DEFAULT, fnv_node_neon)
+
+static struct fnv_kernels const fnv_kernels_neon = {"neon", fnv_mix_neon, dag_parents_neon};
+
+#endif
+
+/******** Selection ********/
+
+// Run @a k and the scalar kernels on the same pseudo random input and compare.
+static bool fnv_kernels_check(struct fnv_kernels const* k)
+{
+	enum { cache_count = 64, item_count = 3 };
+	uint32_t const indices[item_count] = {1000, 7, 1001};
+	node cache[cache_count];
+	node expected[item_count];
+	node actual[item_count];
+	uint32_t x = 0x9e3779b9;
+	for (unsigned i = 0; i != cache_count; ++i) {
+		for (unsigned w = 0; w != NODE_WORDS; ++w) {
+			x = fnv_hash(x, i * NODE_WORDS + w) ^ (x >> 13);
+			cache[i].words[w] = x;
+		}
+	}
+	memcpy(expected, cache, sizeof(expected));
+	memcpy(actual, cache, sizeof(actual));
+	dag_parents_scalar(expected, indices, item_count, cache, ethash_divisor(cache_count));
+	k->dag_parents(actual, indices, item_count, cache, ethash_divisor(cache_count));
+	fnv_mix_scalar(expected[0].words, cache[5].words, 2 * NODE_WORDS);
+	k->mix(actual[0].words, cache[5].words, 2 * NODE_WORDS);
+	return memcmp(expected, actual, sizeof(expected)) == 0;
+}
+
+// The kernel sets by the nonzero index fnv_select_kernels() returns.
+enum { FNV_SET_SCALAR = 1, FNV_SET_SSE41, FNV_SET_AVX2, FNV_SET_NEON };
+static struct fnv_kernels const* const fnv_kernel_sets[] = {
+	[FNV_SET_SCALAR] = &fnv_kernels_scalar,
+#if defined(FNV_X86)
+	[FNV_SET_SSE41] = &fnv_kernels_sse41,
+	[FNV_SET_AVX2] = &fnv_kernels_avx2,
+#elif defined(FNV_NEON)
+	[FNV_SET_NEON] = &fnv_kernels_neon,
+#endif
+};
+
+static uint32_t fnv_select_kernels(void)
+{
+	uint32_t candidates[3];
+	unsigned n = 0;
+#if defined(FNV_X86)
+	if (fnv_cpu_has_avx2()) {
+		candidates[n++] = FNV_SET_AVX2;
+	}
+	if (fnv_cpu_has_sse41()) {
+		candidates[n++] = FNV_SET_SSE41;
+	}
+#elif defined(FNV_NEON)
+	candidates[n++] = FNV_SET_NEON;
+#endif
+	for (unsigned i = 0; i != n; ++i) {
+		if (fnv_kernels_check(fnv_kernel_sets[candidates[i]])) {
+			return candidates[i];
+		}
+	}
+	return FNV_SET_SCALAR;
+}
+
+static struct fnv_kernels const* fnv_kernels(void)
+{
+	static uint32_t selected = 0;
+	return fnv_kernel_sets[ethash_once(&selected, fnv_select_kernels)];
+}
+
+void ethash_fnv_mix(uint32_t* restrict mix, uint32_t const* restrict data, unsigned words)
+{
+	fnv_kernels()->mix(mix, data, words);
+}
+
+void ethash_dag_parents(node* items, uint32_t const* indices, uint32_t n, node const* cache_nodes, ethash_divisor_t num_parent_nodes)
+{
+	fnv_kernels()->dag_parents(items, indices, n, cache_nodes, num_parent_nodes);
+}
+
+char const* ethash_fnv_kernel(void)
+{
+	return fnv_kernels()->name;
+}
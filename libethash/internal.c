@@ -30,6 +30,163 @@
 #include "data_sizes.h"
 #include "sha3.h"
 
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+static void* ethash_aligned_alloc(size_t size)
+{
+#if defined(_WIN32)
+	return _aligned_malloc(size, CACHE_LINE_BYTES);
+#else
+	void* ret;
+	if (posix_memalign(&ret, CACHE_LINE_BYTES, size) != 0) {
+		return NULL;
+	}
+	return ret;
+#endif
+}
+
+static void ethash_aligned_free(void* ptr)
+{
+#if defined(_WIN32)
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+// Ways of an item cache set. With its counters a set takes ten cache lines.
+#define ETHASH_ITEM_CACHE_WAYS 4
+
+struct ethash_item_entry {
+	uint32_t seq;			// odd while the entry is written
+	uint32_t tag;			// mix page index + 1, 0 if empty
+	uint32_t referenced;	// hit since the clock hand last passed
+	uint32_t padding;
+	node items[MIX_NODES];
+};
+
+struct ethash_item_set {
+	uint64_t hits;
+	uint64_t misses;
+	uint32_t hand;			// way the clock looks at first for a victim
+	uint32_t padding[11];
+	struct ethash_item_entry ways[ETHASH_ITEM_CACHE_WAYS];
+};
+
+struct ethash_item_cache {
+	struct ethash_item_set* sets;
+	uint32_t mask;			// number of sets - 1
+};
+
+// Copies the cached items of mix page @a index to @a out.
+// Entries are seqlocks: a read racing with a write sees the sequence change and misses.
+static bool ethash_item_cache_get(struct ethash_item_cache* cache, uint32_t index, node* out)
+{
+	struct ethash_item_set* const set = &cache->sets[index & cache->mask];
+	for (unsigned w = 0; w != ETHASH_ITEM_CACHE_WAYS; ++w) {
+		struct ethash_item_entry* const e = &set->ways[w];
+		uint32_t const seq = ethash_load_acquire(&e->seq);
+		if ((seq & 1) || ethash_load_acquire(&e->tag) != index + 1) {
+			continue;
+		}
+		memcpy(out, e->items, sizeof(e->items));
+		ethash_fence_acquire();
+		if (ethash_load_acquire(&e->seq) != seq) {
+			continue;
+		}
+		if (!ethash_load_acquire(&e->referenced)) {
+			ethash_store_release(&e->referenced, 1);
+		}
+		ethash_count(&set->hits);
+		return true;
+	}
+	ethash_count(&set->misses);
+	return false;
+}
+
+// Stores the items of mix page @a index in the first entry of its set the clock finds
+// unreferenced. Gives up if other threads hold every entry.
+static void ethash_item_cache_put(struct ethash_item_cache* cache, uint32_t index, node const* items)
+{
+	struct ethash_item_set* const set = &cache->sets[index & cache->mask];
+	uint32_t const hand = ethash_load_acquire(&set->hand);
+	// the first round may only clear the referenced bits
+	for (unsigned i = 0; i != 2 * ETHASH_ITEM_CACHE_WAYS; ++i) {
+		unsigned const w = (hand + i) % ETHASH_ITEM_CACHE_WAYS;
+		struct ethash_item_entry* const e = &set->ways[w];
+		uint32_t const seq = ethash_load_acquire(&e->seq);
+		if (seq & 1) {
+			continue;
+		}
+		if (ethash_load_acquire(&e->referenced)) {
+			ethash_store_release(&e->referenced, 0);
+			continue;
+		}
+		if (!ethash_cas(&e->seq, seq, seq + 1)) {
+			continue;
+		}
+		ethash_store_release(&e->tag, index + 1);
+		memcpy(e->items, items, sizeof(e->items));
+		ethash_store_release(&e->seq, seq + 2);
+		ethash_store_release(&set->hand, (w + 1) % ETHASH_ITEM_CACHE_WAYS);
+		return;
+	}
+}
+
+// Computes the items of mix page @a index from @a light, or takes them from its item cache.
+static void ethash_light_mix_page(ethash_light_t const light, uint32_t index, node* out)
+{
+	if (light->items && ethash_item_cache_get(light->items, index, out)) {
+		return;
+	}
+	ethash_calculate_dag_items(out, index * MIX_NODES, MIX_NODES, light);
+	if (light->items) {
+		ethash_item_cache_put(light->items, index, out);
+	}
+}
+
+bool ethash_light_set_item_cache(ethash_light_t light, uint64_t bytes)
+{
+	if (light->items) {
+		ethash_aligned_free(light->items->sets);
+		free(light->items);
+		light->items = NULL;
+	}
+	if (!bytes) {
+		return true;
+	}
+	uint64_t sets = 1;
+	while (sets * 2 * sizeof(struct ethash_item_set) <= bytes && sets * 2 <= (1ULL << 31)) {
+		sets *= 2;
+	}
+	struct ethash_item_cache* cache = calloc(sizeof(*cache), 1);
+	if (!cache) {
+		return false;
+	}
+	cache->sets = ethash_aligned_alloc((size_t)(sets * sizeof(struct ethash_item_set)));
+	if (!cache->sets) {
+		free(cache);
+		return false;
+	}
+	memset(cache->sets, 0, (size_t)(sets * sizeof(struct ethash_item_set)));
+	cache->mask = (uint32_t)(sets - 1);
+	light->items = cache;
+	return true;
+}
+
+void ethash_light_item_cache_stats(ethash_light_t light, uint64_t* hits, uint64_t* misses)
+{
+	if (!light->items) {
+		return;
+	}
+	for (uint64_t s = 0; s <= light->items->mask; ++s) {
+		*hits += ethash_load_counter(&light->items->sets[s].hits);
+		*misses += ethash_load_counter(&light->items->sets[s].misses);
+	}
+}
+
 uint64_t ethash_get_datasize(uint64_t const block_number)
 {
     return dag_sizes[etchash_calc_epoch(block_number)];
@@ -43,7 +200,7 @@ uint64_t ethash_get_cachesize(uint64_t const block_number)
 // Follows Sergio's "STRICT MEMORY HARD HASHING FUNCTIONS" (2014)
 // https://bitslog.files.wordpress.com/2013/12/memohash-v0-3.pdf
 // SeqMemoHash(s, R, N)
-bool static ethash_compute_cache_nodes(
+bool ethash_compute_cache_nodes(
 	node* const nodes,
 	uint64_t cache_size,
 	ethash_h256_t const* seed
@@ -53,22 +210,23 @@ bool static ethash_compute_cache_nodes(
 		return false;
 	}
 	uint32_t const num_nodes = (uint32_t) (cache_size / sizeof(node));
+	ethash_divisor_t const num_nodes_div = ethash_divisor(num_nodes);
 
 	SHA3_512(nodes[0].bytes, (uint8_t*)seed, 32);
 
 	for (uint32_t i = 1; i != num_nodes; ++i) {
-		SHA3_512(nodes[i].bytes, nodes[i - 1].bytes, 64);
+		sha3_512_64(nodes[i].bytes, nodes[i - 1].bytes);
 	}
 
 	for (uint32_t j = 0; j != ETHASH_CACHE_ROUNDS; j++) {
 		for (uint32_t i = 0; i != num_nodes; i++) {
-			uint32_t const idx = nodes[i].words[0] % num_nodes;
+			uint32_t const idx = ethash_mod(nodes[i].words[0], num_nodes_div);
 			node data;
-			data = nodes[(num_nodes - 1 + i) % num_nodes];
+			data = nodes[i ? i - 1 : num_nodes - 1];
 			for (uint32_t w = 0; w != NODE_WORDS; ++w) {
 				data.words[w] ^= nodes[idx].words[w];
 			}
-			SHA3_512(nodes[i].bytes, data.bytes, sizeof(data));
+			sha3_512_64(nodes[i].bytes, data.bytes);
 		}
 	}
 
@@ -83,55 +241,87 @@ void ethash_calculate_dag_item(
 	ethash_light_t const light
 )
 {
-	uint32_t num_parent_nodes = (uint32_t) (light->cache_size / sizeof(node));
+	ethash_calculate_dag_items(ret, node_index, 1, light);
+}
+
+void ethash_calculate_dag_items_indexed(
+	node* const ret,
+	uint32_t const* indices,
+	uint32_t count,
+	ethash_light_t const light
+)
+{
 	node const* cache_nodes = (node const *) light->cache;
-	node const* init = &cache_nodes[node_index % num_parent_nodes];
-	memcpy(ret, init, sizeof(node));
-	ret->words[0] ^= node_index;
-	SHA3_512(ret->bytes, ret->bytes, sizeof(node));
-#if defined(_M_X64) && ENABLE_SSE
-	__m128i const fnv_prime = _mm_set1_epi32(FNV_PRIME);
-	__m128i xmm0 = ret->xmm[0];
-	__m128i xmm1 = ret->xmm[1];
-	__m128i xmm2 = ret->xmm[2];
-	__m128i xmm3 = ret->xmm[3];
-#endif
+	uint8_t* bytes[ETHASH_DAG_BATCH];
+
+	for (uint32_t first = 0; first < count; first += ETHASH_DAG_BATCH) {
+		node* const items = ret + first;
+		uint32_t const n = count - first < ETHASH_DAG_BATCH ? count - first : ETHASH_DAG_BATCH;
+		for (uint32_t k = 0; k != n; ++k) {
+			memcpy(&items[k], &cache_nodes[ethash_mod(indices[first + k], light->num_parent_nodes)], sizeof(node));
+			items[k].words[0] ^= indices[first + k];
+			bytes[k] = items[k].bytes;
+		}
+		sha3_512_multi(bytes, 64, (uint8_t const* const*)bytes, sizeof(node), n);
+		ethash_dag_parents(items, indices + first, n, cache_nodes, light->num_parent_nodes);
+		sha3_512_multi(bytes, 64, (uint8_t const* const*)bytes, sizeof(node), n);
+	}
+}
 
-	for (uint32_t i = 0; i != ETHASH_DATASET_PARENTS; ++i) {
-		uint32_t parent_index = fnv_hash(node_index ^ i, ret->words[i % NODE_WORDS]) % num_parent_nodes;
-		node const *parent = &cache_nodes[parent_index];
-
-#if defined(_M_X64) && ENABLE_SSE
-		{
-			xmm0 = _mm_mullo_epi32(xmm0, fnv_prime);
-			xmm1 = _mm_mullo_epi32(xmm1, fnv_prime);
-			xmm2 = _mm_mullo_epi32(xmm2, fnv_prime);
-			xmm3 = _mm_mullo_epi32(xmm3, fnv_prime);
-			xmm0 = _mm_xor_si128(xmm0, parent->xmm[0]);
-			xmm1 = _mm_xor_si128(xmm1, parent->xmm[1]);
-			xmm2 = _mm_xor_si128(xmm2, parent->xmm[2]);
-			xmm3 = _mm_xor_si128(xmm3, parent->xmm[3]);
-
-			// have to write to ret as values are used to compute index
-			ret->xmm[0] = xmm0;
-			ret->xmm[1] = xmm1;
-			ret->xmm[2] = xmm2;
-			ret->xmm[3] = xmm3;
+void ethash_calculate_dag_items(
+	node* const ret,
+	uint32_t node_index,
+	uint32_t count,
+	ethash_light_t const light
+)
+{
+	uint32_t indices[ETHASH_DAG_BATCH];
+	for (uint32_t first = 0; first < count; first += ETHASH_DAG_BATCH) {
+		uint32_t const n = count - first < ETHASH_DAG_BATCH ? count - first : ETHASH_DAG_BATCH;
+		for (uint32_t k = 0; k != n; ++k) {
+			indices[k] = node_index + first + k;
 		}
-		#else
-		{
-			for (unsigned w = 0; w != NODE_WORDS; ++w) {
-				ret->words[w] = fnv_hash(ret->words[w], parent->words[w]);
-			}
+		ethash_calculate_dag_items_indexed(ret + first, indices, n, light);
+	}
+}
+
+static bool ethash_compute_full_data(
+	node* const full_nodes,
+	uint64_t full_size,
+	ethash_light_t const light,
+	ethash_callback_t callback
+)
+{
+	if (full_size % (sizeof(uint32_t) * MIX_WORDS) != 0 ||
+		(full_size % sizeof(node)) != 0) {
+		return false;
+	}
+	uint32_t const max_n = (uint32_t)(full_size / sizeof(node));
+	uint32_t const progress_step = max_n / 100 ? max_n / 100 : 1;
+	// now compute full nodes
+	for (uint32_t n = 0; n < max_n; n += progress_step) {
+		if (callback &&
+				callback((unsigned)((uint64_t)n * 100 / max_n)) != 0) {
+			return false;
 		}
-#endif
+		uint32_t const count = max_n - n < progress_step ? max_n - n : progress_step;
+		ethash_calculate_dag_items(&(full_nodes[n]), n, count, light);
 	}
-	SHA3_512(ret->bytes, ret->bytes, sizeof(node));
+	return true;
 }
 
+static void ethash_hash_mix(
+	node* const s_mix,
+	node const* full_nodes,
+	ethash_lazy_t const lazy,
+	ethash_light_t const light,
+	ethash_divisor_t const num_full_pages
+);
+
 static bool ethash_hash(
 	ethash_return_value_t* ret,
 	node const* full_nodes,
+	ethash_lazy_t const lazy,
 	ethash_light_t const light,
 	uint64_t full_size,
 	ethash_h256_t const header_hash,
@@ -149,54 +339,36 @@ static bool ethash_hash(
 	fix_endian64(s_mix[0].double_words[4], nonce);
 
 	// compute sha3-512 hash and replicate across mix
-	SHA3_512(s_mix->bytes, s_mix->bytes, 40);
+	sha3_512_40(s_mix->bytes, s_mix->bytes);
+	ethash_hash_mix(s_mix, full_nodes, lazy, light, ethash_full_pages(full_size));
+
+	memcpy(&ret->mix_hash, s_mix[1].bytes, 32);
+	// final Keccak hash
+	sha3_256_96(ret->result.b, s_mix->bytes); // Keccak-256(s + compressed_mix)
+	return true;
+}
+
+// Replicate the seed hash in s_mix[0] across the mix in s_mix[1..MIX_NODES].
+static inline void ethash_mix_init(node* const s_mix)
+{
 	fix_endian_arr32(s_mix[0].words, 16);
 
 	node* const mix = s_mix + 1;
 	for (uint32_t w = 0; w != MIX_WORDS; ++w) {
 		mix->words[w] = s_mix[0].words[w % NODE_WORDS];
 	}
+}
 
-	unsigned const page_size = sizeof(uint32_t) * MIX_WORDS;
-	unsigned const num_full_pages = (unsigned) (full_size / page_size);
-
-	for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {
-		uint32_t const index = fnv_hash(s_mix->words[0] ^ i, mix->words[i % MIX_WORDS]) % num_full_pages;
-
-		for (unsigned n = 0; n != MIX_NODES; ++n) {
-			node const* dag_node;
-			if (full_nodes) {
-				dag_node = &full_nodes[MIX_NODES * index + n];
-			} else {
-				node tmp_node;
-				ethash_calculate_dag_item(&tmp_node, index * MIX_NODES + n, light);
-				dag_node = &tmp_node;
-			}
-
-#if defined(_M_X64) && ENABLE_SSE
-			{
-				__m128i fnv_prime = _mm_set1_epi32(FNV_PRIME);
-				__m128i xmm0 = _mm_mullo_epi32(fnv_prime, mix[n].xmm[0]);
-				__m128i xmm1 = _mm_mullo_epi32(fnv_prime, mix[n].xmm[1]);
-				__m128i xmm2 = _mm_mullo_epi32(fnv_prime, mix[n].xmm[2]);
-				__m128i xmm3 = _mm_mullo_epi32(fnv_prime, mix[n].xmm[3]);
-				mix[n].xmm[0] = _mm_xor_si128(xmm0, dag_node->xmm[0]);
-				mix[n].xmm[1] = _mm_xor_si128(xmm1, dag_node->xmm[1]);
-				mix[n].xmm[2] = _mm_xor_si128(xmm2, dag_node->xmm[2]);
-				mix[n].xmm[3] = _mm_xor_si128(xmm3, dag_node->xmm[3]);
-			}
-			#else
-			{
-				for (unsigned w = 0; w != NODE_WORDS; ++w) {
-					mix[n].words[w] = fnv_hash(mix[n].words[w], dag_node->words[w]);
-				}
-			}
-#endif
-		}
-
-	}
+// The page of the dataset read by access @a i.
+static inline uint32_t ethash_mix_page(node const* const s_mix, unsigned i, ethash_divisor_t const num_full_pages)
+{
+	return ethash_mod(fnv_hash(s_mix->words[0] ^ i, s_mix[1].words[i % MIX_WORDS]), num_full_pages);
+}
 
-	// compress mix
+// Compress the mix into the first 32 bytes of s_mix[1].
+static inline void ethash_mix_compress(node* const s_mix)
+{
+	node* const mix = s_mix + 1;
 	for (uint32_t w = 0; w != MIX_WORDS; w += 4) {
 		uint32_t reduction = mix->words[w + 0];
 		reduction = reduction * FNV_PRIME ^ mix->words[w + 1];
@@ -206,19 +378,72 @@ static bool ethash_hash(
 	}
 
 	fix_endian_arr32(mix->words, MIX_WORDS / 4);
-	memcpy(&ret->mix_hash, mix->bytes, 32);
-	// final Keccak hash
-	SHA3_256(&ret->result, s_mix->bytes, 64 + 32); // Keccak-256(s + compressed_mix)
-	return true;
+}
+
+// The mix page @a index of a lazy dataset, computing the dataset page holding it on first
+// use. If another thread is computing that page, the mix page is computed into @a tmp
+// instead of waiting.
+static node const* ethash_lazy_mix_page(ethash_lazy_t const lazy, uint32_t index, node* tmp)
+{
+	uint64_t const first = (uint64_t)index * MIX_NODES;
+	uint64_t const page = first / ETHASH_LAZY_PAGE_NODES;
+	uint32_t* const state = &lazy->page_states[page];
+	if (ethash_load_acquire(state) == ETHASH_LAZY_READY) {
+		return &lazy->data[first];
+	}
+	if (!ethash_cas(state, ETHASH_LAZY_EMPTY, ETHASH_LAZY_BUSY)) {
+		if (ethash_load_acquire(state) == ETHASH_LAZY_READY) {
+			return &lazy->data[first];
+		}
+		ethash_calculate_dag_items(tmp, (uint32_t)first, MIX_NODES, lazy->light);
+		return tmp;
+	}
+	uint64_t const begin = page * ETHASH_LAZY_PAGE_NODES;
+	uint64_t const total = lazy->size / sizeof(node);
+	uint64_t const end = begin + ETHASH_LAZY_PAGE_NODES < total ? begin + ETHASH_LAZY_PAGE_NODES : total;
+	ethash_calculate_dag_items(&lazy->data[begin], (uint32_t)begin, (uint32_t)(end - begin), lazy->light);
+	ethash_store_release(state, ETHASH_LAZY_READY);
+	ethash_fetch_add(&lazy->pages_ready, 1);
+	return &lazy->data[first];
+}
+
+static void ethash_hash_mix(
+	node* const s_mix,
+	node const* full_nodes,
+	ethash_lazy_t const lazy,
+	ethash_light_t const light,
+	ethash_divisor_t const num_full_pages
+)
+{
+	node* const mix = s_mix + 1;
+
+	ethash_mix_init(s_mix);
+	for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {
+		uint32_t const index = ethash_mix_page(s_mix, i, num_full_pages);
+
+		if (full_nodes) {
+			ethash_fnv_mix(mix->words, full_nodes[MIX_NODES * index].words, MIX_WORDS);
+		} else if (lazy) {
+			node tmp_nodes[MIX_NODES];
+			ethash_fnv_mix(mix->words, ethash_lazy_mix_page(lazy, index, tmp_nodes)->words, MIX_WORDS);
+		} else {
+			node tmp_nodes[MIX_NODES];
+			ethash_light_mix_page(light, index, tmp_nodes);
+			ethash_fnv_mix(mix->words, tmp_nodes[0].words, MIX_WORDS);
+		}
+	}
+	ethash_mix_compress(s_mix);
 }
 
 ethash_h256_t ethash_get_seedhash(uint64_t block_number)
 {
 	ethash_h256_t ret;
 	ethash_h256_reset(&ret);
-	uint64_t const epochs = block_number / ETHASH_EPOCH_LENGTH;
+	// ECIP-1099: a 60000 block epoch has the seed of the 30000 block epoch it starts with.
+	uint64_t const epochs = block_number >= ETCHASH_FORK_BLOCK ?
+		block_number / ETHASH_EPOCH_LENGTH_NEW * 2 : block_number / ETHASH_EPOCH_LENGTH;
 	for (uint32_t i = 0; i < epochs; ++i)
-		SHA3_256(&ret, (uint8_t*)&ret, 32);
+		sha3_256_32(ret.b, ret.b);
 	return ret;
 }
 
@@ -229,7 +454,7 @@ ethash_light_t ethash_light_new_internal(uint64_t cache_size, ethash_h256_t cons
 	if (!ret) {
 		return NULL;
 	}
-	ret->cache = malloc((size_t)cache_size);
+	ret->cache = ethash_aligned_alloc((size_t)cache_size);
 	if (!ret->cache) {
 		goto fail_free_light;
 	}
@@ -238,15 +463,31 @@ ethash_light_t ethash_light_new_internal(uint64_t cache_size, ethash_h256_t cons
 		goto fail_free_cache_mem;
 	}
 	ret->cache_size = cache_size;
+	ret->num_parent_nodes = ethash_divisor((uint32_t)(cache_size / sizeof(node)));
 	return ret;
 
 fail_free_cache_mem:
-	free(ret->cache);
+	ethash_aligned_free(ret->cache);
 fail_free_light:
 	free(ret);
 	return NULL;
 }
 
+ethash_light_t ethash_light_wrap_internal(void* cache, uint64_t cache_size, uint64_t block_number)
+{
+	struct ethash_light *ret;
+	ret = calloc(sizeof(*ret), 1);
+	if (!ret) {
+		return NULL;
+	}
+	ret->cache = cache;
+	ret->cache_size = cache_size;
+	ret->num_parent_nodes = ethash_divisor((uint32_t)(cache_size / sizeof(node)));
+	ret->block_number = block_number;
+	ret->borrowed = true;
+	return ret;
+}
+
 ethash_light_t ethash_light_new(uint64_t block_number)
 {
 	ethash_h256_t seedhash = ethash_get_seedhash(block_number);
@@ -258,8 +499,9 @@ ethash_light_t ethash_light_new(uint64_t block_number)
 
 void ethash_light_delete(ethash_light_t light)
 {
-	if (light->cache) {
-		free(light->cache);
+	ethash_light_set_item_cache(light, 0);
+	if (light->cache && !light->borrowed) {
+		ethash_aligned_free(light->cache);
 	}
 	free(light);
 }
@@ -279,7 +521,7 @@ ethash_return_value_t ethash_light_compute_internal(
 {
   	ethash_return_value_t ret;
 	ret.success = true;
-	if (!ethash_hash(&ret, NULL, light, full_size, header_hash, nonce)) {
+	if (!ethash_hash(&ret, NULL, NULL, light, full_size, header_hash, nonce)) {
 		ret.success = false;
 	}
 	return ret;
@@ -294,3 +536,270 @@ ethash_return_value_t ethash_light_compute(
 	uint64_t full_size = ethash_get_datasize(light->block_number);
 	return ethash_light_compute_internal(light, full_size, header_hash, nonce);
 }
+
+void ethash_light_compute_batch_internal(
+	ethash_light_t light,
+	uint64_t full_size,
+	ethash_h256_t const* header_hashes,
+	uint64_t const* nonces,
+	unsigned count,
+	ethash_return_value_t* ret
+)
+{
+	ethash_divisor_t const num_full_pages = ethash_full_pages(full_size);
+	node s_mix[ETHASH_HASH_LANES][MIX_NODES + 1];
+	node pages[ETHASH_HASH_LANES][MIX_NODES];
+	node computed[ETHASH_HASH_LANES][MIX_NODES];
+	uint32_t indices[ETHASH_HASH_LANES * MIX_NODES];
+	unsigned lanes[ETHASH_HASH_LANES];
+	uint8_t* seeds[ETHASH_HASH_LANES];
+	uint8_t* results[ETHASH_HASH_LANES];
+	bool const valid = full_size % MIX_WORDS == 0;
+
+	for (unsigned first = 0; first < count; first += ETHASH_HASH_LANES) {
+		unsigned const n = count - first < ETHASH_HASH_LANES ? count - first : ETHASH_HASH_LANES;
+		for (unsigned k = 0; k != n; ++k) {
+			memcpy(s_mix[k][0].bytes, &header_hashes[first + k], 32);
+			fix_endian64(s_mix[k][0].double_words[4], nonces[first + k]);
+			seeds[k] = s_mix[k][0].bytes;
+			results[k] = ret[first + k].result.b;
+			ret[first + k].success = valid;
+		}
+		if (!valid) {
+			continue;
+		}
+		sha3_512_multi(seeds, 64, (uint8_t const* const*)seeds, 40, n);
+		for (unsigned k = 0; k != n; ++k) {
+			ethash_mix_init(s_mix[k]);
+		}
+
+		// Generate the pages of all nonces together, so their parent lookups in the
+		// light cache overlap instead of each nonce waiting on its own.
+		for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {
+			unsigned missing = 0;
+			for (unsigned k = 0; k != n; ++k) {
+				uint32_t const index = ethash_mix_page(s_mix[k], i, num_full_pages);
+				if (light->items && ethash_item_cache_get(light->items, index, pages[k])) {
+					continue;
+				}
+				for (unsigned m = 0; m != MIX_NODES; ++m) {
+					indices[missing * MIX_NODES + m] = index * MIX_NODES + m;
+				}
+				lanes[missing++] = k;
+			}
+			if (missing) {
+				ethash_calculate_dag_items_indexed(computed[0], indices, missing * MIX_NODES, light);
+			}
+			for (unsigned j = 0; j != missing; ++j) {
+				memcpy(pages[lanes[j]], computed[j], sizeof(computed[j]));
+				if (light->items) {
+					ethash_item_cache_put(light->items, indices[j * MIX_NODES] / MIX_NODES, computed[j]);
+				}
+			}
+			for (unsigned k = 0; k != n; ++k) {
+				ethash_fnv_mix(s_mix[k][1].words, pages[k][0].words, MIX_WORDS);
+			}
+		}
+
+		for (unsigned k = 0; k != n; ++k) {
+			ethash_mix_compress(s_mix[k]);
+			memcpy(&ret[first + k].mix_hash, s_mix[k][1].bytes, 32);
+		}
+		// Keccak-256(s + compressed_mix)
+		sha3_256_multi(results, 32, (uint8_t const* const*)seeds, 64 + 32, n);
+	}
+}
+
+void ethash_light_compute_batch(
+	ethash_light_t light,
+	ethash_h256_t const* header_hashes,
+	uint64_t const* nonces,
+	unsigned count,
+	ethash_return_value_t* ret
+)
+{
+	uint64_t full_size = ethash_get_datasize(light->block_number);
+	ethash_light_compute_batch_internal(light, full_size, header_hashes, nonces, count, ret);
+}
+
+ethash_return_value_t ethash_full_compute_internal(
+	node const* full_nodes,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+)
+{
+	ethash_return_value_t ret;
+	ret.success = true;
+	if (!ethash_hash(&ret, full_nodes, NULL, NULL, full_size, header_hash, nonce)) {
+		ret.success = false;
+	}
+	return ret;
+}
+
+bool ethash_full_compute_batch_internal(
+	node const* full_nodes,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t start_nonce,
+	unsigned count,
+	ethash_return_value_t* ret
+)
+{
+	if (full_size % MIX_WORDS != 0) {
+		return false;
+	}
+	ethash_divisor_t const num_full_pages = ethash_full_pages(full_size);
+	node s_mix[ETHASH_HASH_LANES][MIX_NODES + 1];
+	uint8_t* seeds[ETHASH_HASH_LANES];
+	uint8_t* results[ETHASH_HASH_LANES];
+
+	for (unsigned first = 0; first < count; first += ETHASH_HASH_LANES) {
+		unsigned const n = count - first < ETHASH_HASH_LANES ? count - first : ETHASH_HASH_LANES;
+		for (unsigned k = 0; k != n; ++k) {
+			memcpy(s_mix[k][0].bytes, &header_hash, 32);
+			fix_endian64(s_mix[k][0].double_words[4], start_nonce + first + k);
+			seeds[k] = s_mix[k][0].bytes;
+			results[k] = ret[first + k].result.b;
+		}
+		sha3_512_multi(seeds, 64, (uint8_t const* const*)seeds, 40, n);
+		for (unsigned k = 0; k != n; ++k) {
+			ethash_hash_mix(s_mix[k], full_nodes, NULL, NULL, num_full_pages);
+			memcpy(&ret[first + k].mix_hash, s_mix[k][1].bytes, 32);
+			ret[first + k].success = true;
+		}
+		// Keccak-256(s + compressed_mix)
+		sha3_256_multi(results, 32, (uint8_t const* const*)seeds, 64 + 32, n);
+	}
+	return true;
+}
+
+ethash_full_t ethash_full_alloc_internal(uint64_t full_size, uint64_t block_number)
+{
+	struct ethash_full* ret;
+	if (full_size % (sizeof(uint32_t) * MIX_WORDS) != 0) {
+		return NULL;
+	}
+	ret = calloc(sizeof(*ret), 1);
+	if (!ret) {
+		return NULL;
+	}
+	ret->data = ethash_aligned_alloc((size_t)full_size);
+	if (!ret->data) {
+		free(ret);
+		return NULL;
+	}
+	ret->size = full_size;
+	ret->block_number = block_number;
+	return ret;
+}
+
+ethash_full_t ethash_full_wrap_internal(node* data, uint64_t full_size, uint64_t block_number)
+{
+	struct ethash_full* ret;
+	if (full_size % (sizeof(uint32_t) * MIX_WORDS) != 0) {
+		return NULL;
+	}
+	ret = calloc(sizeof(*ret), 1);
+	if (!ret) {
+		return NULL;
+	}
+	ret->data = data;
+	ret->size = full_size;
+	ret->block_number = block_number;
+	ret->borrowed = true;
+	return ret;
+}
+
+ethash_full_t ethash_full_new_internal(
+	uint64_t full_size,
+	ethash_light_t const light,
+	ethash_callback_t callback
+)
+{
+	ethash_full_t ret = ethash_full_alloc_internal(full_size, light->block_number);
+	if (!ret) {
+		return NULL;
+	}
+	if (!ethash_compute_full_data(ret->data, full_size, light, callback)) {
+		ethash_full_delete(ret);
+		return NULL;
+	}
+	return ret;
+}
+
+ethash_full_t ethash_full_new(ethash_light_t light, ethash_callback_t callback)
+{
+	uint64_t full_size = ethash_get_datasize(light->block_number);
+	return ethash_full_new_internal(full_size, light, callback);
+}
+
+void ethash_full_delete(ethash_full_t full)
+{
+	if (full->data && !full->borrowed) {
+		ethash_aligned_free(full->data);
+	}
+	free(full);
+}
+
+ethash_return_value_t ethash_full_compute(
+	ethash_full_t full,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+)
+{
+	return ethash_full_compute_internal(full->data, full->size, header_hash, nonce);
+}
+
+void const* ethash_full_dag(ethash_full_t full)
+{
+	return full->data;
+}
+
+uint64_t ethash_full_dag_size(ethash_full_t full)
+{
+	return full->size;
+}
+
+ethash_lazy_t ethash_lazy_new_internal(node* data, uint64_t full_size, ethash_light_t light)
+{
+	struct ethash_lazy* ret;
+	if (full_size % (sizeof(uint32_t) * MIX_WORDS) != 0) {
+		return NULL;
+	}
+	ret = calloc(sizeof(*ret), 1);
+	if (!ret) {
+		return NULL;
+	}
+	ret->page_states = calloc((size_t)((full_size + ETHASH_LAZY_PAGE_BYTES - 1) / ETHASH_LAZY_PAGE_BYTES), sizeof(uint32_t));
+	if (!ret->page_states) {
+		free(ret);
+		return NULL;
+	}
+	ret->data = data;
+	ret->size = full_size;
+	ret->light = light;
+	return ret;
+}
+
+void ethash_lazy_delete(ethash_lazy_t lazy)
+{
+	free(lazy->page_states);
+	free(lazy);
+}
+
+ethash_return_value_t ethash_lazy_compute(
+	ethash_lazy_t lazy,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+)
+{
+	ethash_return_value_t ret;
+	ret.success = ethash_hash(&ret, NULL, lazy, lazy->light, lazy->size, header_hash, nonce);
+	return ret;
+}
+
+uint32_t ethash_lazy_pages_ready(ethash_lazy_t lazy)
+{
+	return ethash_load_acquire(&lazy->pages_ready);
+}
@@ -2,33 +2,28 @@
 #include "compiler.h"
 #include "endian.h"
 #include "ethash.h"
+#include "fastmod.h"
 #include <stdio.h>
 
-#define ENABLE_SSE 0
-
-#if defined(_M_X64) && ENABLE_SSE
-#include <smmintrin.h>
-#endif
-
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // compile time settings
 #define NODE_WORDS (64/4)
+#define CACHE_LINE_BYTES 64
 #define MIX_WORDS (ETHASH_MIX_BYTES/4)
 #define MIX_NODES (MIX_WORDS / NODE_WORDS)
+// number of independent hashes batch functions compute together, the widest Keccak kernel
+#define ETHASH_HASH_LANES 8
+// maximum number of DAG items whose parent lookups are interleaved
+#define ETHASH_DAG_BATCH (ETHASH_HASH_LANES * MIX_NODES)
 #include <stdint.h>
 
 typedef union node {
 	uint8_t bytes[NODE_WORDS * 4];
 	uint32_t words[NODE_WORDS];
 	uint64_t double_words[NODE_WORDS / 2];
-
-#if defined(_M_X64) && ENABLE_SSE
-	__m128i xmm[NODE_WORDS/4];
-#endif
-
 } node;
 
 static inline void ethash_h256_reset(ethash_h256_t* hash)
@@ -36,10 +31,56 @@ static inline void ethash_h256_reset(ethash_h256_t* hash)
 	memset(hash, 0, 32);
 }
 
+struct ethash_item_cache;
+
 struct ethash_light {
 	void* cache;
 	uint64_t cache_size;
 	uint64_t block_number;
+	bool borrowed;	// cache is owned by the caller and not freed with the handler
+	struct ethash_item_cache* items;	// recently computed DAG items, NULL if disabled
+	ethash_divisor_t num_parent_nodes;	// cache_size / sizeof(node)
+};
+
+struct ethash_full {
+	node* data;
+	uint64_t size;
+	uint64_t block_number;
+	bool borrowed;	// data is owned by the caller and not freed with the handler
+};
+
+// The number of 128 byte pages a hash reads from, of a dataset of @a full_size bytes.
+static inline ethash_divisor_t ethash_full_pages(uint64_t full_size)
+{
+	return ethash_divisor((uint32_t)(full_size / (sizeof(uint32_t) * MIX_WORDS)));
+}
+
+// A search for nonces whose hash of a header against a full dataset meets a target.
+typedef struct ethash_search {
+	node const* full_nodes;
+	uint64_t full_size;
+	ethash_divisor_t num_full_pages;
+	ethash_h256_t header;
+	uint64_t target;	// largest first 8 bytes of a candidate's result, read big endian
+	uint64_t state[25];	// Keccak-512 state with the header and the padding absorbed
+	bool gather;	// whether 32 bit gather indices reach every word of the dataset
+} ethash_search_t;
+
+// A lazy dataset computes its pages on first use, each page holding this many DAG items.
+#define ETHASH_LAZY_PAGE_BYTES 4096
+#define ETHASH_LAZY_PAGE_NODES (ETHASH_LAZY_PAGE_BYTES / ETHASH_HASH_BYTES)
+
+// states of a lazy dataset page
+#define ETHASH_LAZY_EMPTY 0
+#define ETHASH_LAZY_BUSY 1
+#define ETHASH_LAZY_READY 2
+
+struct ethash_lazy {
+	node* data;
+	uint64_t size;
+	ethash_light_t light;
+	uint32_t* page_states;	// one ETHASH_LAZY_* per page of data, claimed with a CAS
+	uint32_t pages_ready;
 };
 
 /**
@@ -53,6 +94,43 @@ struct ethash_light {
  */
 ethash_light_t ethash_light_new_internal(uint64_t cache_size, ethash_h256_t const* seed);
 
+/**
+ * Compute the light cache for @a seed into @a nodes, which holds @a cache_size bytes.
+ *
+ * @return              false if @a cache_size is invalid
+ */
+bool ethash_compute_cache_nodes(
+	node* const nodes,
+	uint64_t cache_size,
+	ethash_h256_t const* seed
+);
+
+/**
+ * Create an ethash_light handler for a cache already held in memory owned by the caller,
+ * e.g. one mapped from disk. The memory must outlive the handler and is not freed by
+ * @ref ethash_light_delete().
+ *
+ * @param cache         The cache nodes, aligned to a cache line
+ * @param cache_size    The size of the cache in bytes
+ * @param block_number  The block number the cache was generated for
+ * @return              Newly allocated ethash_light handler or NULL in case of ERRNOMEM
+ */
+ethash_light_t ethash_light_wrap_internal(void* cache, uint64_t cache_size, uint64_t block_number);
+
+/**
+ * Keep up to @a bytes of the DAG items computed by light hashes of @a light, so hashes
+ * reading the same parts of the dataset reuse them. Items are kept in the pairs a hash
+ * reads, in a set associative cache whose sets are locked separately, each evicting the
+ * pair least recently hit in clock order. Lookups never block. Must be called before
+ * @a light is used by several threads; 0 bytes disables the cache.
+ *
+ * @return              false in case of ERRNOMEM
+ */
+bool ethash_light_set_item_cache(ethash_light_t light, uint64_t bytes);
+
+/// Adds the item cache lookups of @a light which found, or didn't find, their pair.
+void ethash_light_item_cache_stats(ethash_light_t light, uint64_t* hits, uint64_t* misses);
+
 /**
  * Calculate the light client data. Internal version.
  *
@@ -69,12 +147,224 @@ ethash_return_value_t ethash_light_compute_internal(
 	uint64_t nonce
 );
 
+/**
+ * Allocate and initialize a new ethash_full handler. Internal version.
+ *
+ * @param full_size     The size of the full data in bytes.
+ * @param light         The light handler containing the cache.
+ * @param callback      A callback function with signature of @ref ethash_callback_t
+ *                      It accepts an unsigned with which a progress of DAG calculation
+ *                      can be displayed. If all goes well the callback should return 0.
+ *                      If a non-zero value is returned then DAG generation will stop.
+ * @return              Newly allocated ethash_full handler or NULL in case of
+ *                      ERRNOMEM or an aborted DAG generation
+ */
+ethash_full_t ethash_full_new_internal(
+	uint64_t full_size,
+	ethash_light_t const light,
+	ethash_callback_t callback
+);
+
+/**
+ * Allocate a new ethash_full handler without computing the dataset. The caller is
+ * expected to fill every node, e.g. with @ref ethash_calculate_dag_item from several
+ * threads. The dataset is aligned to a cache line.
+ *
+ * @param full_size     The size of the full data in bytes.
+ * @param block_number  The block number the dataset is generated for
+ * @return              Newly allocated ethash_full handler or NULL in case of
+ *                      ERRNOMEM or an invalid @a full_size
+ */
+ethash_full_t ethash_full_alloc_internal(uint64_t full_size, uint64_t block_number);
+
+/**
+ * Create an ethash_full handler for a dataset already held in memory owned by the caller,
+ * e.g. one mapped from disk. The memory must outlive the handler and is not freed by
+ * @ref ethash_full_delete().
+ *
+ * @param data          The dataset, aligned to a cache line
+ * @param full_size     The size of the full data in bytes.
+ * @param block_number  The block number the dataset was generated for
+ * @return              Newly allocated ethash_full handler or NULL in case of
+ *                      ERRNOMEM or an invalid @a full_size
+ */
+ethash_full_t ethash_full_wrap_internal(node* data, uint64_t full_size, uint64_t block_number);
+
+/**
+ * Create a dataset whose pages are computed from @a light when a hash first reads them.
+ * Pages stay computed, so hashing gets close to full dataset speed once the pages in
+ * use are filled while only those take memory. Hashes may run on several threads; a
+ * page is computed by the first thread needing it, the others don't wait for it.
+ *
+ * @param data          Room for the dataset, aligned to a cache line, owned by the caller.
+ *                      Best reserved such that untouched pages take no memory.
+ * @param full_size     The size of the full data in bytes.
+ * @param light         The light handler of the same epoch; must outlive the handler
+ * @return              Newly allocated ethash_lazy handler or NULL in case of
+ *                      ERRNOMEM or an invalid @a full_size
+ */
+ethash_lazy_t ethash_lazy_new_internal(node* data, uint64_t full_size, ethash_light_t light);
+void ethash_lazy_delete(ethash_lazy_t lazy);
+
+/**
+ * Calculate the full client data from a lazy dataset, computing the pages it reads
+ * which are not yet.
+ */
+ethash_return_value_t ethash_lazy_compute(
+	ethash_lazy_t lazy,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+);
+
+/// @returns the number of computed pages of @a lazy.
+uint32_t ethash_lazy_pages_ready(ethash_lazy_t lazy);
+
+/**
+ * Calculate the full client data from an already generated dataset. Internal version.
+ *
+ * @param full_nodes     The full dataset, (full_size / sizeof(node)) nodes
+ * @param full_size      The size of the full data in bytes.
+ * @param header_hash    The header hash to pack into the mix
+ * @param nonce          The nonce to pack into the mix
+ * @return               The resulting hash.
+ */
+ethash_return_value_t ethash_full_compute_internal(
+	node const* full_nodes,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+);
+
+/**
+ * Hash @a count consecutive nonces against an already generated dataset, using
+ * the multi-lane Keccak kernels for the seed and final hashes.
+ *
+ * @param full_nodes     The full dataset, (full_size / sizeof(node)) nodes
+ * @param full_size      The size of the full data in bytes.
+ * @param header_hash    The header hash to pack into the mix
+ * @param start_nonce    The nonce of ret[0]; ret[i] is computed for start_nonce + i
+ * @param count          The number of nonces to hash
+ * @param ret            Array of at least @a count results
+ * @return               false if @a full_size is invalid
+ */
+bool ethash_full_compute_batch_internal(
+	node const* full_nodes,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t start_nonce,
+	unsigned count,
+	ethash_return_value_t* ret
+);
+
+/**
+ * Prepare a nonce search of @a header against an already generated dataset.
+ *
+ * @param full_nodes     The full dataset, (full_size / sizeof(node)) nodes
+ * @param full_size      The size of the full data in bytes.
+ * @param target         Nonces are candidates if the first 8 bytes of their result,
+ *                       read big endian, are at most @a target
+ * @return               false if @a full_size is invalid
+ */
+bool ethash_search_init(
+	ethash_search_t* search,
+	node const* full_nodes,
+	uint64_t full_size,
+	ethash_h256_t const* header,
+	uint64_t target
+);
+
+/**
+ * Hash the @a count nonces from @a start_nonce and collect the candidates. Nonces are
+ * hashed ethash_search_lanes() per SIMD register, with the pages of several registers'
+ * worth of nonces prefetched together. A candidate's result still has to be compared
+ * with the whole boundary, e.g. after @ref ethash_full_compute_internal.
+ *
+ * @param found          Receives the first @a max_found candidates
+ * @return               The number of candidates, which may exceed @a max_found
+ */
+unsigned ethash_search_run(
+	ethash_search_t const* search,
+	uint64_t start_nonce,
+	unsigned count,
+	uint64_t* found,
+	unsigned max_found
+);
+
+/// @returns the number of nonces hashed per SIMD register on this CPU: 16 with AVX-512,
+/// 8 with AVX2, 4 with SSE2/NEON and 1 without vector support.
+unsigned ethash_search_lanes(void);
+
 void ethash_calculate_dag_item(
 	node* const ret,
 	uint32_t node_index,
 	ethash_light_t const cache
 );
 
+/**
+ * Calculate @a count consecutive DAG items starting at @a node_index into ret[0..count).
+ * Same result as @ref ethash_calculate_dag_item per item, but several items are hashed
+ * together with the multi-lane Keccak kernels.
+ */
+void ethash_calculate_dag_items(
+	node* const ret,
+	uint32_t node_index,
+	uint32_t count,
+	ethash_light_t const cache
+);
+
+/**
+ * Calculate the DAG items indices[0..count) into ret[0..count).
+ */
+void ethash_calculate_dag_items_indexed(
+	node* const ret,
+	uint32_t const* indices,
+	uint32_t count,
+	ethash_light_t const cache
+);
+
+/**
+ * Calculate the light client data for @a count (header, nonce) pairs at once.
+ * Internal version.
+ *
+ * @param light          The light client handler
+ * @param full_size      The size of the full data in bytes.
+ * @param header_hashes  The header hash of each pair
+ * @param nonces         The nonce of each pair
+ * @param count          The number of pairs
+ * @param ret            Array of at least @a count results
+ */
+void ethash_light_compute_batch_internal(
+	ethash_light_t light,
+	uint64_t full_size,
+	ethash_h256_t const* header_hashes,
+	uint64_t const* nonces,
+	unsigned count,
+	ethash_return_value_t* ret
+);
+
+/**
+ * FNV-mix @a words words of @a data into @a mix, words being a multiple of NODE_WORDS.
+ * Uses the fastest of the scalar, SSE4.1, AVX2 or NEON kernels that reproduces the
+ * scalar result on this CPU.
+ */
+void ethash_fnv_mix(uint32_t* restrict mix, uint32_t const* restrict data, unsigned words);
+
+/**
+ * Mix the ETHASH_DATASET_PARENTS parents into the @a n items (at most ETHASH_DAG_BATCH),
+ * which hold the initial hashes of DAG items indices[0..n). The parents of all items
+ * are prefetched together each round. Same kernel choice as @ref ethash_fnv_mix.
+ */
+void ethash_dag_parents(
+	node* items,
+	uint32_t const* indices,
+	uint32_t n,
+	node const* cache_nodes,
+	ethash_divisor_t num_parent_nodes
+);
+
+/// @returns the name of the FNV kernels in use: "avx2", "sse4.1", "neon" or "scalar".
+char const* ethash_fnv_kernel(void);
+
 uint64_t ethash_get_datasize(uint64_t const block_number);
 uint64_t ethash_get_cachesize(uint64_t const block_number);
 static uint64_t etchash_calc_epoch(uint64_t const block_number);
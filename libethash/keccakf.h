@@ -0,0 +1,111 @@
+/*
+* The Keccak-f[1600] permutation, written out for any type with 64 bit
+* lanes: uint64_t for sha3.c, GCC vectors of them for the multi-lane
+* kernels of sha3_lanes.h and search_lanes.h.
+*/
+
+#pragma once
+#include <stdint.h>
+
+static const uint64_t keccak_rc[24] = \
+	{1ULL, 0x8082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+	 0x808bULL, 0x80000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+	 0x8aULL, 0x88ULL, 0x80008009ULL, 0x8000000aULL,
+	 0x8000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+	 0x8000000000008002ULL, 0x8000000000000080ULL, 0x800aULL, 0x800000008000000aULL,
+	 0x8000000080008081ULL, 0x8000000000008080ULL, 0x80000001ULL, 0x8000000080008008ULL};
+
+#define keccak_rol(x, s) (((x) << (s)) | ((x) >> (64 - (s))))
+
+// One round from the lanes A##ba .. A##su into E##ba .. E##su, written out so that
+// the state lives in 25 locals the compiler can keep in registers, instead of being
+// indexed through memory. Lanes are named by row (b, g, k, m, s for y = 0 .. 4) and
+// column (a, e, i, o, u for x = 0 .. 4). Each output row gathers its five inputs
+// through rho and pi, then applies chi; iota goes into the first.
+#define KECCAK_ROUND(A, E, rc)											\
+	Ca = A##ba ^ A##ga ^ A##ka ^ A##ma ^ A##sa;							\
+	Ce = A##be ^ A##ge ^ A##ke ^ A##me ^ A##se;							\
+	Ci = A##bi ^ A##gi ^ A##ki ^ A##mi ^ A##si;							\
+	Co = A##bo ^ A##go ^ A##ko ^ A##mo ^ A##so;							\
+	Cu = A##bu ^ A##gu ^ A##ku ^ A##mu ^ A##su;							\
+	Da = Cu ^ keccak_rol(Ce, 1);										\
+	De = Ca ^ keccak_rol(Ci, 1);										\
+	Di = Ce ^ keccak_rol(Co, 1);										\
+	Do = Ci ^ keccak_rol(Cu, 1);										\
+	Du = Co ^ keccak_rol(Ca, 1);										\
+																		\
+	Ba = A##ba ^ Da;													\
+	Be = keccak_rol(A##ge ^ De, 44);									\
+	Bi = keccak_rol(A##ki ^ Di, 43);									\
+	Bo = keccak_rol(A##mo ^ Do, 21);									\
+	Bu = keccak_rol(A##su ^ Du, 14);									\
+	E##ba = Ba ^ (~Be & Bi) ^ (rc);										\
+	E##be = Be ^ (~Bi & Bo);											\
+	E##bi = Bi ^ (~Bo & Bu);											\
+	E##bo = Bo ^ (~Bu & Ba);											\
+	E##bu = Bu ^ (~Ba & Be);											\
+																		\
+	Ba = keccak_rol(A##bo ^ Do, 28);									\
+	Be = keccak_rol(A##gu ^ Du, 20);									\
+	Bi = keccak_rol(A##ka ^ Da, 3);										\
+	Bo = keccak_rol(A##me ^ De, 45);									\
+	Bu = keccak_rol(A##si ^ Di, 61);									\
+	E##ga = Ba ^ (~Be & Bi);											\
+	E##ge = Be ^ (~Bi & Bo);											\
+	E##gi = Bi ^ (~Bo & Bu);											\
+	E##go = Bo ^ (~Bu & Ba);											\
+	E##gu = Bu ^ (~Ba & Be);											\
+																		\
+	Ba = keccak_rol(A##be ^ De, 1);										\
+	Be = keccak_rol(A##gi ^ Di, 6);										\
+	Bi = keccak_rol(A##ko ^ Do, 25);									\
+	Bo = keccak_rol(A##mu ^ Du, 8);										\
+	Bu = keccak_rol(A##sa ^ Da, 18);									\
+	E##ka = Ba ^ (~Be & Bi);											\
+	E##ke = Be ^ (~Bi & Bo);											\
+	E##ki = Bi ^ (~Bo & Bu);											\
+	E##ko = Bo ^ (~Bu & Ba);											\
+	E##ku = Bu ^ (~Ba & Be);											\
+																		\
+	Ba = keccak_rol(A##bu ^ Du, 27);									\
+	Be = keccak_rol(A##ga ^ Da, 36);									\
+	Bi = keccak_rol(A##ke ^ De, 10);									\
+	Bo = keccak_rol(A##mi ^ Di, 15);									\
+	Bu = keccak_rol(A##so ^ Do, 56);									\
+	E##ma = Ba ^ (~Be & Bi);											\
+	E##me = Be ^ (~Bi & Bo);											\
+	E##mi = Bi ^ (~Bo & Bu);											\
+	E##mo = Bo ^ (~Bu & Ba);											\
+	E##mu = Bu ^ (~Ba & Be);											\
+																		\
+	Ba = keccak_rol(A##bi ^ Di, 62);									\
+	Be = keccak_rol(A##go ^ Do, 55);									\
+	Bi = keccak_rol(A##ku ^ Du, 39);									\
+	Bo = keccak_rol(A##ma ^ Da, 41);									\
+	Bu = keccak_rol(A##se ^ De, 2);										\
+	E##sa = Ba ^ (~Be & Bi);											\
+	E##se = Be ^ (~Bi & Bo);											\
+	E##si = Bi ^ (~Bo & Bu);											\
+	E##so = Bo ^ (~Bu & Ba);											\
+	E##su = Bu ^ (~Ba & Be);
+
+// Keccak-f[1600] on the 25 words of type T at st, two rounds per iteration so A and E
+// swap roles. Shared by the scalar and the multi-lane implementations.
+#define KECCAK_F1600(T, st)												\
+	T Aba = st[0], Abe = st[1], Abi = st[2], Abo = st[3], Abu = st[4];	\
+	T Aga = st[5], Age = st[6], Agi = st[7], Ago = st[8], Agu = st[9];	\
+	T Aka = st[10], Ake = st[11], Aki = st[12], Ako = st[13], Aku = st[14]; \
+	T Ama = st[15], Ame = st[16], Ami = st[17], Amo = st[18], Amu = st[19]; \
+	T Asa = st[20], Ase = st[21], Asi = st[22], Aso = st[23], Asu = st[24]; \
+	T Eba, Ebe, Ebi, Ebo, Ebu, Ega, Ege, Egi, Ego, Egu, Eka, Eke, Eki, Eko, Eku, \
+		Ema, Eme, Emi, Emo, Emu, Esa, Ese, Esi, Eso, Esu;				\
+	T Ca, Ce, Ci, Co, Cu, Da, De, Di, Do, Du, Ba, Be, Bi, Bo, Bu;		\
+	for (int i = 0; i < 24; i += 2) {									\
+		KECCAK_ROUND(A, E, keccak_rc[i])								\
+		KECCAK_ROUND(E, A, keccak_rc[i + 1])							\
+	}																	\
+	st[0] = Aba; st[1] = Abe; st[2] = Abi; st[3] = Abo; st[4] = Abu;	\
+	st[5] = Aga; st[6] = Age; st[7] = Agi; st[8] = Ago; st[9] = Agu;	\
+	st[10] = Aka; st[11] = Ake; st[12] = Aki; st[13] = Ako; st[14] = Aku; \
+	st[15] = Ama; st[16] = Ame; st[17] = Ami; st[18] = Amo; st[19] = Amu; \
+	st[20] = Asa; st[21] = Ase; st[22] = Asi; st[23] = Aso; st[24] = Asu;
@@ -0,0 +1,284 @@
+/*
+  This file is part of ethash.
+
+  ethash is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ethash is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with cpp-ethereum.	If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file search.c
+* Nonce search against a full dataset, several nonces per SIMD register.
+*
+* Like the FNV kernels, a kernel is checked against the scalar hash when it
+* is selected and is only used if both agree bit for bit.
+*/
+
+#include <limits.h>
+#include <string.h>
+#include "endian.h"
+#include "fnv.h"
+#include "internal.h"
+#include "keccakf.h"
+
+// Registers' worth of nonces whose dataset reads are interleaved.
+#define ETHASH_SEARCH_GROUPS 2
+// Nonces hashed by one call of the widest kernel.
+#define ETHASH_SEARCH_MAX (ETHASH_SEARCH_GROUPS * 16)
+
+// The kernels keep lanes in native byte order and use GCC vector extensions.
+#if defined(__GNUC__) && BYTE_ORDER == LITTLE_ENDIAN
+#define SEARCH_VECTORS 1
+#endif
+
+#if defined(SEARCH_VECTORS) && (defined(__x86_64__) || defined(__i386__))
+#define SEARCH_X86 1
+#define SEARCH_TARGET_X8 __attribute__((target("avx2")))
+#define SEARCH_TARGET_X16 __attribute__((target("avx512f")))
+#include <immintrin.h>
+#else
+#define SEARCH_TARGET_X8
+#define SEARCH_TARGET_X16
+#endif
+
+typedef void (*search_fn)(ethash_search_t const* job, uint64_t nonce, uint64_t* hashes);
+
+struct search_kernel {
+	unsigned lanes;
+	search_fn search;
+};
+
+/******** Scalar ********/
+
+static uint64_t search_hash_scalar(ethash_search_t const* job, uint64_t nonce)
+{
+	ethash_return_value_t const r = ethash_full_compute_internal(job->full_nodes, job->full_size, job->header, nonce);
+	uint64_t hash;
+	memcpy(&hash, r.result.b, sizeof(hash));
+	fix_endian64_same(hash);
+	return ethash_swap_u64(hash);
+}
+
+static void search_scalar(ethash_search_t const* job, uint64_t nonce, uint64_t* hashes)
+{
+	hashes[0] = search_hash_scalar(job, nonce);
+}
+
+static struct search_kernel const search_kernel_scalar = {1, search_scalar};
+
+/******** Vector ********/
+
+#if defined(SEARCH_VECTORS)
+
+// 4 nonces: SSE2 on x86-64, NEON on AArch64, both baseline.
+typedef uint32_t search_x4_t __attribute__((vector_size(16)));
+typedef uint64_t search_wide_x4_t __attribute__((vector_size(16)));
+#define LANES 4
+#define LANE_T search_x4_t
+#define WIDE_T search_wide_x4_t
+#define LANE_FN(f) f##_x4
+#define LANE_TARGET
+#include "search_lanes.h"
+#undef LANES
+#undef LANE_T
+#undef WIDE_T
+#undef LANE_FN
+#undef LANE_TARGET
+
+static struct search_kernel const search_kernel_x4 = {4, search_x4};
+
+#endif
+
+#if defined(SEARCH_X86)
+
+// 8 nonces: AVX2.
+typedef uint32_t search_x8_t __attribute__((vector_size(32)));
+typedef uint64_t search_wide_x8_t __attribute__((vector_size(32)));
+#define LANES 8
+#define LANE_T search_x8_t
+#define WIDE_T search_wide_x8_t
+#define LANE_FN(f) f##_x8
+#define LANE_TARGET SEARCH_TARGET_X8
+#define LANE_GATHER(base, offsets) \
+	(search_x8_t)_mm256_i32gather_epi32((int const*)(base), (__m256i)(offsets), 4)
+#include "search_lanes.h"
+#undef LANES
+#undef LANE_T
+#undef WIDE_T
+#undef LANE_FN
+#undef LANE_TARGET
+#undef LANE_GATHER
+
+// 16 nonces: AVX-512.
+typedef uint32_t search_x16_t __attribute__((vector_size(64)));
+typedef uint64_t search_wide_x16_t __attribute__((vector_size(64)));
+#define LANES 16
+#define LANE_T search_x16_t
+#define WIDE_T search_wide_x16_t
+#define LANE_FN(f) f##_x16
+#define LANE_TARGET SEARCH_TARGET_X16
+#define LANE_GATHER(base, offsets) \
+	(search_x16_t)_mm512_i32gather_epi32((__m512i)(offsets), (void const*)(base), 4)
+#include "search_lanes.h"
+#undef LANES
+#undef LANE_T
+#undef WIDE_T
+#undef LANE_FN
+#undef LANE_TARGET
+#undef LANE_GATHER
+
+static struct search_kernel const search_kernel_x8 = {8, search_x8};
+static struct search_kernel const search_kernel_x16 = {16, search_x16};
+
+#endif
+
+/******** Selection ********/
+
+// Search a small pseudo random dataset with @a k and the scalar hash and compare,
+// with and without gathers.
+static bool search_kernel_check(struct search_kernel const* k)
+{
+	enum { pages = 7 };
+	node dataset[pages * MIX_NODES];
+	ethash_h256_t header;
+	ethash_search_t job;
+	uint64_t hashes[ETHASH_SEARCH_MAX];
+	uint32_t x = 0x9e3779b9;
+	for (unsigned i = 0; i != pages * MIX_NODES; ++i) {
+		for (unsigned w = 0; w != NODE_WORDS; ++w) {
+			x = fnv_hash(x, i * NODE_WORDS + w) ^ (x >> 13);
+			dataset[i].words[w] = x;
+		}
+	}
+	for (unsigned i = 0; i != 32; ++i) {
+		header.b[i] = (uint8_t)(i * 37 + 1);
+	}
+	ethash_search_init(&job, dataset, sizeof(dataset), &header, 0);
+	for (unsigned round = 0; round != 2; ++round) {
+		job.gather = round == 0;
+		k->search(&job, 0xfffffffffffffff0ULL, hashes);
+		for (unsigned i = 0; i != k->lanes * ETHASH_SEARCH_GROUPS; ++i) {
+			if (hashes[i] != search_hash_scalar(&job, 0xfffffffffffffff0ULL + i)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// The kernels by the nonzero index search_select_kernel() returns.
+enum { SEARCH_SCALAR = 1, SEARCH_X4, SEARCH_X8, SEARCH_X16 };
+static struct search_kernel const* const search_kernels[] = {
+	[SEARCH_SCALAR] = &search_kernel_scalar,
+#if defined(SEARCH_VECTORS)
+	[SEARCH_X4] = &search_kernel_x4,
+#endif
+#if defined(SEARCH_X86)
+	[SEARCH_X8] = &search_kernel_x8,
+	[SEARCH_X16] = &search_kernel_x16,
+#endif
+};
+
+static uint32_t search_select_kernel(void)
+{
+	uint32_t candidates[3];
+	unsigned n = 0;
+#if defined(SEARCH_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		candidates[n++] = SEARCH_X16;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		candidates[n++] = SEARCH_X8;
+	}
+#endif
+#if defined(SEARCH_VECTORS)
+	candidates[n++] = SEARCH_X4;
+#endif
+	for (unsigned i = 0; i != n; ++i) {
+		if (search_kernel_check(search_kernels[candidates[i]])) {
+			return candidates[i];
+		}
+	}
+	return SEARCH_SCALAR;
+}
+
+static struct search_kernel const* search_kernel(void)
+{
+	static uint32_t selected = 0;
+	return search_kernels[ethash_once(&selected, search_select_kernel)];
+}
+
+unsigned ethash_search_lanes(void)
+{
+	return search_kernel()->lanes;
+}
+
+bool ethash_search_init(
+	ethash_search_t* search,
+	node const* full_nodes,
+	uint64_t full_size,
+	ethash_h256_t const* header,
+	uint64_t target
+)
+{
+	if (full_size % (sizeof(uint32_t) * MIX_WORDS) != 0) {
+		return false;
+	}
+	memset(search, 0, sizeof(*search));
+	search->full_nodes = full_nodes;
+	search->full_size = full_size;
+	search->num_full_pages = ethash_full_pages(full_size);
+	search->header = *header;
+	search->target = target;
+	// Keccak-512 of header || nonce is a single block: the header words, the nonce
+	// word left zero, and the padding.
+	for (unsigned w = 0; w != 4; ++w) {
+		memcpy(&search->state[w], header->b + 8 * w, 8);
+		fix_endian64_same(search->state[w]);
+	}
+	search->state[5] = 0x01;
+	search->state[8] = 0x8000000000000000ULL;
+	search->gather = full_size / sizeof(uint32_t) <= (uint64_t)INT_MAX + 1;
+	return true;
+}
+
+unsigned ethash_search_run(
+	ethash_search_t const* search,
+	uint64_t start_nonce,
+	unsigned count,
+	uint64_t* found,
+	unsigned max_found
+)
+{
+	struct search_kernel const* const k = search_kernel();
+	unsigned const step = k->lanes == 1 ? 1 : k->lanes * ETHASH_SEARCH_GROUPS;
+	uint64_t hashes[ETHASH_SEARCH_MAX];
+	unsigned total = 0;
+	for (unsigned done = 0; done < count; done += step) {
+		if (count - done >= step) {
+			k->search(search, start_nonce + done, hashes);
+		} else {
+			// The tail of a count that isn't a multiple of the step.
+			for (unsigned i = 0; i != count - done; ++i) {
+				hashes[i] = search_hash_scalar(search, start_nonce + done + i);
+			}
+		}
+		for (unsigned i = 0; i != step && done + i < count; ++i) {
+			if (hashes[i] <= search->target) {
+				if (total < max_found) {
+					found[total] = start_nonce + done + i;
+				}
+				++total;
+			}
+		}
+	}
+	return total;
+}
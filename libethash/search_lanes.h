@@ -0,0 +1,118 @@
+/*
+* Nonce search kernel hashing LANES nonces per register.
+*
+* Keeps word w of the mix of LANES nonces in one vector, so the FNV mixing
+* is vertical and each dataset word is gathered from the LANES pages the
+* nonces read. This file has no include guard: search.c includes it once
+* per vector width after defining
+*   LANES        number of nonces per register
+*   LANE_T       GCC vector type holding LANES uint32_t
+*   WIDE_T       GCC vector type of the same size holding LANES / 2 uint64_t
+*   LANE_FN(f)   name of function f for this width
+*   LANE_TARGET  function attribute selecting the instruction set
+*   LANE_GATHER  optional; LANE_GATHER(base, offsets) loads base[offsets[l]]
+*                into lane l with a gather instruction
+*/
+
+static LANE_TARGET void LANE_FN(keccakf)(WIDE_T* st)
+{
+	KECCAK_F1600(WIDE_T, st)
+}
+
+// Hashes the ETHASH_SEARCH_GROUPS * LANES nonces from @a nonce, writing the first 8
+// bytes of each result, read big endian, to hashes.
+static LANE_TARGET void LANE_FN(search)(ethash_search_t const* job, uint64_t nonce, uint64_t* hashes)
+{
+	enum { groups = ETHASH_SEARCH_GROUPS, half = LANES / 2 };
+	// Nonce l of group g is nonce + g * LANES + l. Keccak works on 64 bit lanes, so
+	// it takes a group in two halves.
+	WIDE_T seed[groups][2][8];
+	LANE_T mix[groups][MIX_WORDS];
+	LANE_T seed0[groups];
+	uint32_t pages[groups][LANES];
+	uint32_t const* const dag = job->full_nodes->words;
+
+	// Keccak-512(header || nonce), the header and the padding taken as absorbed already.
+	for (unsigned g = 0; g != groups; ++g) {
+		for (unsigned h = 0; h != 2; ++h) {
+			WIDE_T st[25];
+			for (unsigned w = 0; w != 25; ++w) {
+				st[w] = (WIDE_T){0} + job->state[w];
+			}
+			for (unsigned l = 0; l != half; ++l) {
+				st[4][l] = nonce + g * LANES + h * half + l;
+			}
+			LANE_FN(keccakf)(st);
+			memcpy(seed[g][h], st, sizeof(seed[g][h]));
+		}
+		// Replicate the seed across the mix.
+		for (unsigned j = 0; j != NODE_WORDS; ++j) {
+			LANE_T v;
+			for (unsigned l = 0; l != LANES; ++l) {
+				v[l] = (uint32_t)(seed[g][l / half][j / 2][l % half] >> (32 * (j % 2)));
+			}
+			mix[g][j] = mix[g][j + NODE_WORDS] = v;
+		}
+		seed0[g] = mix[g][0];
+	}
+
+	for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {
+		// Prefetch the pages of every group before reading any, so the loads of
+		// independent nonces overlap instead of each waiting on DRAM in turn.
+		for (unsigned g = 0; g != groups; ++g) {
+			LANE_T const index = (seed0[g] ^ i) * FNV_PRIME ^ mix[g][i % MIX_WORDS];
+			for (unsigned l = 0; l != LANES; ++l) {
+				pages[g][l] = ethash_mod(index[l], job->num_full_pages);
+				node const* const page = &job->full_nodes[(size_t)pages[g][l] * MIX_NODES];
+				ethash_prefetch(page);
+				ethash_prefetch(page + 1);
+			}
+		}
+		for (unsigned g = 0; g != groups; ++g) {
+#if defined(LANE_GATHER)
+			LANE_T offsets;
+			for (unsigned l = 0; l != LANES; ++l) {
+				offsets[l] = pages[g][l] * MIX_WORDS;
+			}
+#endif
+			for (unsigned w = 0; w != MIX_WORDS; ++w) {
+				LANE_T data;
+#if defined(LANE_GATHER)
+				if (job->gather) {
+					data = LANE_GATHER(dag + w, offsets);
+				} else
+#endif
+				{
+					for (unsigned l = 0; l != LANES; ++l) {
+						data[l] = dag[(size_t)pages[g][l] * MIX_WORDS + w];
+					}
+				}
+				mix[g][w] = mix[g][w] * FNV_PRIME ^ data;
+			}
+		}
+	}
+
+	// Keccak-256(seed || compressed mix)
+	for (unsigned g = 0; g != groups; ++g) {
+		LANE_T cmix[MIX_WORDS / 4];
+		for (unsigned w = 0; w != MIX_WORDS; w += 4) {
+			cmix[w / 4] = ((mix[g][w] * FNV_PRIME ^ mix[g][w + 1]) * FNV_PRIME ^ mix[g][w + 2]) * FNV_PRIME ^ mix[g][w + 3];
+		}
+		for (unsigned h = 0; h != 2; ++h) {
+			WIDE_T st[25];
+			memset(st, 0, sizeof(st));
+			memcpy(st, seed[g][h], sizeof(seed[g][h]));
+			for (unsigned w = 0; w != 4; ++w) {
+				for (unsigned l = 0; l != half; ++l) {
+					st[8 + w][l] = cmix[2 * w][h * half + l] | (uint64_t)cmix[2 * w + 1][h * half + l] << 32;
+				}
+			}
+			st[12] = (WIDE_T){0} + 0x01;
+			st[16] = (WIDE_T){0} + 0x8000000000000000ULL;
+			LANE_FN(keccakf)(st);
+			for (unsigned l = 0; l != half; ++l) {
+				hashes[g * LANES + h * half + l] = ethash_swap_u64(st[0][l]);
+			}
+		}
+	}
+}
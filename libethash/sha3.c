@@ -7,6 +7,8 @@
 * but not liability.
 */
 #include "sha3.h"
+#include "endian.h"
+#include "keccakf.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -15,137 +17,250 @@
 
 /******** The Keccak-f[1600] permutation ********/
 
-/*** Constants. ***/
-static const uint8_t rho[24] = \
-	{ 1,  3,   6, 10, 15, 21,
-	  28, 36, 45, 55,  2, 14,
-	  27, 41, 56,  8, 25, 43,
-	  62, 18, 39, 61, 20, 44};
-static const uint8_t pi[24] = \
-	{10,  7, 11, 17, 18, 3,
-	 5, 16,  8, 21, 24, 4,
-	 15, 23, 19, 13, 12, 2,
-	 20, 14, 22,  9, 6,  1};
-static const uint64_t RC[24] = \
-	{1ULL, 0x8082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
-	 0x808bULL, 0x80000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
-	 0x8aULL, 0x88ULL, 0x80008009ULL, 0x8000000aULL,
-	 0x8000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
-	 0x8000000000008002ULL, 0x8000000000000080ULL, 0x800aULL, 0x800000008000000aULL,
-	 0x8000000080008081ULL, 0x8000000000008080ULL, 0x80000001ULL, 0x8000000080008008ULL};
-
-/*** Helper macros to unroll the permutation. ***/
-#define rol(x, s) (((x) << s) | ((x) >> (64 - s)))
-#define REPEAT6(e) e e e e e e
-#define REPEAT24(e) REPEAT6(e e e e)
-#define REPEAT5(e) e e e e e
-#define FOR5(v, s, e)							\
-	v = 0;										\
-	REPEAT5(e; v += s;)
-
-/*** Keccak-f[1600] ***/
-static inline void keccakf(void* state) {
-	uint64_t* a = (uint64_t*)state;
-	uint64_t b[5] = {0};
-	uint64_t t = 0;
-	uint8_t x, y;
-
-	for (int i = 0; i < 24; i++) {
-		// Theta
-		FOR5(x, 1,
-				b[x] = 0;
-				FOR5(y, 5,
-						b[x] ^= a[x + y]; ))
-		FOR5(x, 1,
-				FOR5(y, 5,
-						a[y + x] ^= b[(x + 4) % 5] ^ rol(b[(x + 1) % 5], 1); ))
-		// Rho and pi
-		t = a[1];
-		x = 0;
-		REPEAT24(b[0] = a[pi[x]];
-				a[pi[x]] = rol(t, rho[x]);
-				t = b[0];
-				x++; )
-		// Chi
-		FOR5(y,
-				5,
-				FOR5(x, 1,
-						b[x] = a[y + x];)
-				FOR5(x, 1,
-				a[y + x] = b[x] ^ ((~b[(x + 1) % 5]) & b[(x + 2) % 5]); ))
-		// Iota
-		a[0] ^= RC[i];
-	}
+static inline void keccakf(uint64_t st[25]) {
+	KECCAK_F1600(uint64_t, st)
 }
 
 /******** The FIPS202-defined functions. ********/
 
-/*** Some helper macros. ***/
+// Lanes are little endian.
+static inline uint64_t load64(const uint8_t* p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	fix_endian64_same(v);
+	return v;
+}
+
+static inline void store64(uint8_t* p, uint64_t v) {
+	fix_endian64_same(v);
+	memcpy(p, &v, 8);
+}
 
-#define _(S) do { S } while (0)
-#define FOR(i, ST, L, S)							\
-	_(for (size_t i = 0; i < L; i += ST) { S; })
-#define mkapply_ds(NAME, S)						\
-	static inline void NAME(uint8_t* dst,			\
-		const uint8_t* src,						\
-		size_t len) {								\
-		FOR(i, 1, len, S);							\
+static inline void xorin(uint64_t* a, const uint8_t* in, size_t len) {
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		a[i / 8] ^= load64(in + i);
 	}
-#define mkapply_sd(NAME, S)						\
-	static inline void NAME(const uint8_t* src,	\
-		uint8_t* dst,								\
-		size_t len) {								\
-		FOR(i, 1, len, S);							\
+	for (; i < len; ++i) {
+		a[i / 8] ^= (uint64_t)in[i] << (8 * (i % 8));
 	}
+}
 
-mkapply_ds(xorin, dst[i] ^= src[i])  // xorin
-mkapply_sd(setout, dst[i] = src[i])  // setout
-
-#define P keccakf
-#define Plen 200
-
-// Fold P*F over the full blocks of an input.
-#define foldP(I, L, F)								\
-	while (L >= rate) {							\
-		F(a, I, rate);								\
-		P(a);										\
-		I += rate;									\
-		L -= rate;									\
+static inline void setout(const uint64_t* a, uint8_t* out, size_t len) {
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		store64(out + i, a[i / 8]);
+	}
+	for (; i < len; ++i) {
+		out[i] = (uint8_t)(a[i / 8] >> (8 * (i % 8)));
 	}
+}
 
 /** The sponge-based hash construction. **/
 static inline int hash(uint8_t* out, size_t outlen,
 		const uint8_t* in, size_t inlen,
 		size_t rate, uint8_t delim) {
-	if ((out == NULL) || ((in == NULL) && inlen != 0) || (rate >= Plen)) {
+	if ((out == NULL) || ((in == NULL) && inlen != 0) || (rate >= 200)) {
 		return -1;
 	}
-	uint8_t a[Plen] = {0};
+	uint64_t a[25] = {0};
 	// Absorb input.
-	foldP(in, inlen, xorin);
-	// Xor in the DS and pad frame.
-	a[inlen] ^= delim;
-	a[rate - 1] ^= 0x80;
-	// Xor in the last block.
+	for (; inlen >= rate; in += rate, inlen -= rate) {
+		xorin(a, in, rate);
+		keccakf(a);
+	}
+	// Xor in the last block, the DS and the pad frame.
 	xorin(a, in, inlen);
-	// Apply P
-	P(a);
+	a[inlen / 8] ^= (uint64_t)delim << (8 * (inlen % 8));
+	a[rate / 8 - 1] ^= 0x8000000000000000ULL;
+	keccakf(a);
 	// Squeeze output.
-	foldP(out, outlen, setout);
+	for (; outlen >= rate; out += rate, outlen -= rate) {
+		setout(a, out, rate);
+		keccakf(a);
+	}
 	setout(a, out, outlen);
-	memset(a, 0, 200);
 	return 0;
 }
 
-#define defsha3(bits)													\
-	int sha3_##bits(uint8_t* out, size_t outlen,						\
-		const uint8_t* in, size_t inlen) {								\
+// A whole word input shorter than the rate, so a single block, and a whole word output.
+// Called with constants, the loops unroll and the state never leaves registers.
+static inline void hash_block(uint8_t* out, size_t outlen, const uint8_t* in, size_t inlen, size_t rate) {
+	uint64_t a[25] = {0};
+	for (size_t i = 0; i < inlen / 8; ++i) {
+		a[i] = load64(in + 8 * i);
+	}
+	a[inlen / 8] = 0x01;
+	a[rate / 8 - 1] ^= 0x8000000000000000ULL;
+	keccakf(a);
+	for (size_t i = 0; i < outlen / 8; ++i) {
+		store64(out + 8 * i, a[i]);
+	}
+}
+
+/*** The fixed sizes of ethash ***/
+void sha3_256_32(uint8_t* out, const uint8_t* in) {
+	hash_block(out, 32, in, 32, 136);
+}
+
+void sha3_256_96(uint8_t* out, const uint8_t* in) {
+	hash_block(out, 32, in, 96, 136);
+}
+
+void sha3_512_40(uint8_t* out, const uint8_t* in) {
+	hash_block(out, 64, in, 40, 72);
+}
+
+void sha3_512_64(uint8_t* out, const uint8_t* in) {
+	hash_block(out, 64, in, 64, 72);
+}
+
+/*** FIPS202 SHA3 FOFs ***/
+int sha3_256(uint8_t* out, size_t outlen, const uint8_t* in, size_t inlen) {
+	if (outlen > 32) {
+		return -1;
+	}
+	if (outlen == 32 && out && in) {
+		if (inlen == 32) {
+			sha3_256_32(out, in);
+			return 0;
+		}
+		if (inlen == 96) {
+			sha3_256_96(out, in);
+			return 0;
+		}
+	}
+	return hash(out, outlen, in, inlen, 136, 0x01);
+}
+
+int sha3_512(uint8_t* out, size_t outlen, const uint8_t* in, size_t inlen) {
+	if (outlen > 64) {
+		return -1;
+	}
+	if (outlen == 64 && out && in) {
+		if (inlen == 40) {
+			sha3_512_40(out, in);
+			return 0;
+		}
+		if (inlen == 64) {
+			sha3_512_64(out, in);
+			return 0;
+		}
+	}
+	return hash(out, outlen, in, inlen, 72, 0x01);
+}
+
+/******** Multi-lane hashing of independent inputs. ********/
+
+#if defined(__GNUC__)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA3_LANES_X86 1
+#define LANE_TARGET_X4 __attribute__((target("avx2")))
+#define LANE_TARGET_X8 __attribute__((target("avx512f")))
+#else
+#define LANE_TARGET_X4
+#define LANE_TARGET_X8
+#endif
+
+// 2 lanes: SSE2 on x86-64, NEON on AArch64, both baseline.
+typedef uint64_t lane_x2_t __attribute__((vector_size(16)));
+#define LANES 2
+#define LANE_T lane_x2_t
+#define LANE_FN(f) f##_x2
+#define LANE_TARGET
+#include "sha3_lanes.h"
+#undef LANES
+#undef LANE_T
+#undef LANE_FN
+#undef LANE_TARGET
+
+// 4 lanes: AVX2.
+typedef uint64_t lane_x4_t __attribute__((vector_size(32)));
+#define LANES 4
+#define LANE_T lane_x4_t
+#define LANE_FN(f) f##_x4
+#define LANE_TARGET LANE_TARGET_X4
+#include "sha3_lanes.h"
+#undef LANES
+#undef LANE_T
+#undef LANE_FN
+#undef LANE_TARGET
+
+// 8 lanes: AVX-512.
+typedef uint64_t lane_x8_t __attribute__((vector_size(64)));
+#define LANES 8
+#define LANE_T lane_x8_t
+#define LANE_FN(f) f##_x8
+#define LANE_TARGET LANE_TARGET_X8
+#include "sha3_lanes.h"
+#undef LANES
+#undef LANE_T
+#undef LANE_FN
+#undef LANE_TARGET
+
+#endif
+
+static uint32_t detect_lanes(void) {
+#if defined(SHA3_LANES_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return 8;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		return 4;
+	}
+#endif
+#if defined(__GNUC__)
+	return 2;
+#else
+	return 1;
+#endif
+}
+
+unsigned sha3_lanes(void) {
+	static uint32_t lanes = 0;
+	return ethash_once(&lanes, detect_lanes);
+}
+
+static int hash_multi(uint8_t* const* out, size_t outlen,
+		uint8_t const* const* in, size_t inlen, unsigned n,
+		size_t rate, uint8_t delim) {
+	unsigned i = 0;
+	if ((out == NULL) || (in == NULL) || (outlen > rate)) {
+		return -1;
+	}
+#if defined(__GNUC__)
+	unsigned const lanes = sha3_lanes();
+	if (lanes >= 8) {
+		for (; n - i >= 8; i += 8) {
+			hash_x8(out + i, outlen, in + i, inlen, rate, delim);
+		}
+	}
+	if (lanes >= 4) {
+		for (; n - i >= 4; i += 4) {
+			hash_x4(out + i, outlen, in + i, inlen, rate, delim);
+		}
+	}
+	for (; n - i >= 2; i += 2) {
+		hash_x2(out + i, outlen, in + i, inlen, rate, delim);
+	}
+#endif
+	for (; i < n; ++i) {
+		hash(out[i], outlen, in[i], inlen, rate, delim);
+	}
+	return 0;
+}
+
+#define defsha3_multi(bits)												\
+	int sha3_##bits##_multi(uint8_t* const* out, size_t outlen,		\
+		uint8_t const* const* in, size_t inlen, unsigned n) {			\
 		if (outlen > (bits/8)) {										\
-			return -1;                                                  \
+			return -1;													\
 		}																\
-		return hash(out, outlen, in, inlen, 200 - (bits / 4), 0x01);	\
+		return hash_multi(out, outlen, in, inlen, n,					\
+			200 - (bits / 4), 0x01);									\
 	}
 
-/*** FIPS202 SHA3 FOFs ***/
-defsha3(256)
-defsha3(512)
+defsha3_multi(256)
+defsha3_multi(512)
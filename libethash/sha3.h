@@ -13,8 +13,26 @@ struct ethash_h256;
 #define decsha3(bits) \
 	int sha3_##bits(uint8_t*, size_t, uint8_t const*, size_t);
 
+#define decsha3_multi(bits) \
+	int sha3_##bits##_multi(uint8_t* const*, size_t, uint8_t const* const*, size_t, unsigned);
+
 decsha3(256)
 decsha3(512)
+decsha3_multi(256)
+decsha3_multi(512)
+
+// Fixed-size versions for ethash: seeds (32 bytes), header hash || nonce (40 bytes),
+// cache and DAG nodes (64 bytes) and seed || compressed mix (96 bytes). sha3_256 and
+// sha3_512 use them for these sizes too.
+void sha3_256_32(uint8_t* out, uint8_t const* in);
+void sha3_256_96(uint8_t* out, uint8_t const* in);
+void sha3_512_40(uint8_t* out, uint8_t const* in);
+void sha3_512_64(uint8_t* out, uint8_t const* in);
+
+/// Number of inputs the fastest Keccak kernel on this CPU hashes at once: 8 with
+/// AVX-512, 4 with AVX2, 2 with SSE2/NEON and 1 if only the scalar implementation
+/// is available.
+unsigned sha3_lanes(void);
 
 static inline void SHA3_256(struct ethash_h256 const* ret, uint8_t const* data, size_t const size)
 {
@@ -26,6 +44,37 @@ static inline void SHA3_512(uint8_t* ret, uint8_t const* data, size_t const size
 	sha3_512(ret, 64, data, size);
 }
 
+// Batch versions hashing independent inputs of equal size. ret[i] may alias data[i].
+static inline void SHA3_256_x2(uint8_t* const ret[2], uint8_t const* const data[2], size_t const size)
+{
+	sha3_256_multi(ret, 32, data, size, 2);
+}
+
+static inline void SHA3_256_x4(uint8_t* const ret[4], uint8_t const* const data[4], size_t const size)
+{
+	sha3_256_multi(ret, 32, data, size, 4);
+}
+
+static inline void SHA3_256_x8(uint8_t* const ret[8], uint8_t const* const data[8], size_t const size)
+{
+	sha3_256_multi(ret, 32, data, size, 8);
+}
+
+static inline void SHA3_512_x2(uint8_t* const ret[2], uint8_t const* const data[2], size_t const size)
+{
+	sha3_512_multi(ret, 64, data, size, 2);
+}
+
+static inline void SHA3_512_x4(uint8_t* const ret[4], uint8_t const* const data[4], size_t const size)
+{
+	sha3_512_multi(ret, 64, data, size, 4);
+}
+
+static inline void SHA3_512_x8(uint8_t* const ret[8], uint8_t const* const data[8], size_t const size)
+{
+	sha3_512_multi(ret, 64, data, size, 8);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,53 @@
+/*
+* Multi-lane Keccak-f[1600] sponge.
+*
+* Hashes LANES independent, equally long inputs at once by keeping one
+* vector of LANES 64-bit words per state word. This file has no include
+* guard: sha3.c includes it once per vector width after defining
+*   LANES        number of lanes
+*   LANE_T       GCC vector type holding LANES uint64_t
+*   LANE_FN(f)   name of function f for this width
+*   LANE_TARGET  function attribute selecting the instruction set
+*/
+
+static LANE_TARGET void LANE_FN(keccakf)(LANE_T* a)
+{
+	KECCAK_F1600(LANE_T, a)
+}
+
+static LANE_TARGET void LANE_FN(hash)(uint8_t* const* out, size_t outlen,
+		uint8_t const* const* in, size_t inlen,
+		size_t rate, uint8_t delim)
+{
+	LANE_T a[25];
+	uint8_t last[200];
+	size_t off = 0;
+	memset(a, 0, sizeof(a));
+	// Absorb full blocks.
+	for (; inlen - off >= rate; off += rate) {
+		for (size_t w = 0; w != rate / 8; ++w) {
+			for (unsigned l = 0; l != LANES; ++l) {
+				a[w][l] ^= load64(in[l] + off + 8 * w);
+			}
+		}
+		LANE_FN(keccakf)(a);
+	}
+	// Pad and absorb the last block.
+	for (unsigned l = 0; l != LANES; ++l) {
+		memset(last, 0, rate);
+		memcpy(last, in[l] + off, inlen - off);
+		last[inlen - off] ^= delim;
+		last[rate - 1] ^= 0x80;
+		for (size_t w = 0; w != rate / 8; ++w) {
+			a[w][l] ^= load64(last + 8 * w);
+		}
+	}
+	LANE_FN(keccakf)(a);
+	// Squeeze; callers guarantee outlen <= rate.
+	for (unsigned l = 0; l != LANES; ++l) {
+		for (size_t w = 0; w != (outlen + 7) / 8; ++w) {
+			store64(last + 8 * w, a[w][l]);
+		}
+		memcpy(out[l], last, outlen);
+	}
+}
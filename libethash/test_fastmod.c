@@ -0,0 +1,78 @@
+/*
+  This file is part of ethash.
+
+  ethash is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ethash is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ethash.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file test_fastmod.c
+ * Checks ethash_mod() against % for every divisor the hashes use.
+ *
+ * The divisors are the cache item, DAG item and DAG page counts of all epochs in
+ * data_sizes.h. Each is tried with the dividends around its multiples where an
+ * error in the reciprocal would show first, and with a pseudo random sequence.
+ */
+
+#include <stdio.h>
+#include "data_sizes.h"
+#include "fastmod.h"
+#include "ethash.h"
+
+static unsigned failures = 0;
+
+static void check(uint32_t x, ethash_divisor_t const div)
+{
+	uint32_t const expected = x % div.d;
+	uint32_t const fast = ethash_mod(x, div);
+	uint32_t const portable = ethash_mod_portable(x, div);
+	if (fast != expected || portable != expected) {
+		if (failures++ < 10) {
+			printf("%u %% %u: expected %u, ethash_mod %u, portable %u\n", x, div.d, expected, fast, portable);
+		}
+	}
+}
+
+static void check_divisor(uint32_t d)
+{
+	ethash_divisor_t const div = ethash_divisor(d);
+	uint32_t x = d ^ 0x9e3779b9;
+	// the last multiple of d below 2^32, and the first few
+	uint32_t const last = UINT32_MAX - UINT32_MAX % d;
+	uint32_t const ends[] = {0, d, 2 * d, last - d, last};
+	for (unsigned e = 0; e != sizeof(ends) / sizeof(ends[0]); ++e) {
+		for (uint32_t k = 0; k != 3; ++k) {
+			check(ends[e] + k, div);
+			check(ends[e] - k, div);
+		}
+	}
+	check(UINT32_MAX, div);
+	for (unsigned i = 0; i != 4096; ++i) {
+		x = x * 1664525 + 1013904223;
+		check(x, div);
+	}
+}
+
+int main(void)
+{
+	unsigned const epochs = sizeof(dag_sizes) / sizeof(dag_sizes[0]);
+	for (unsigned e = 0; e != epochs; ++e) {
+		check_divisor((uint32_t)(cache_sizes[e] / ETHASH_HASH_BYTES));
+		check_divisor((uint32_t)(dag_sizes[e] / ETHASH_HASH_BYTES));
+		check_divisor((uint32_t)(dag_sizes[e] / ETHASH_MIX_BYTES));
+	}
+	if (failures) {
+		printf("ethash_mod: %u wrong remainders\n", failures);
+		return 1;
+	}
+	printf("ethash_mod: divisors of %u epochs ok\n", epochs);
+	return 0;
+}
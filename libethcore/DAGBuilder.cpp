@@ -0,0 +1,98 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file DAGBuilder.cpp
+ * Parallel generation of the full ethash dataset on the CPU.
+ */
+
+#include "DAGBuilder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <libethash/internal.h>
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+const uint32_t DAGBuilder::c_chunkSize;
+
+DAGBuilder::DAGBuilder(unsigned _threads):
+	m_threads(_threads ? _threads : max(thread::hardware_concurrency(), 1u))
+{}
+
+bool DAGBuilder::build(ethash_full_t _full, ethash_light_t _light, Progress const& _progress) const
+{
+	node* nodes = (node*)ethash_full_dag(_full);
+	uint32_t const count = (uint32_t)(ethash_full_dag_size(_full) / sizeof(node));
+
+	atomic<uint32_t> next(0);
+	atomic<uint32_t> done(0);
+	atomic<bool> abort(false);
+	mutex x_done;
+	condition_variable doneChanged;
+
+	auto generate = [&]()
+	{
+		uint32_t begin;
+		while (!abort.load(memory_order_relaxed) && (begin = next.fetch_add(c_chunkSize)) < count)
+		{
+			uint32_t const end = min(begin + c_chunkSize, count);
+			ethash_calculate_dag_items(&nodes[begin], begin, end - begin, _light);
+			if (done.fetch_add(end - begin) + (end - begin) == count)
+			{
+				lock_guard<mutex> l(x_done);
+				doneChanged.notify_all();
+			}
+		}
+	};
+
+	vector<thread> workers;
+	workers.reserve(m_threads);
+	for (unsigned i = 0; i != m_threads; ++i)
+		workers.emplace_back(generate);
+
+	// Report progress from here so the callback never runs concurrently with itself.
+	unsigned lastPercent = ~0u;
+	while (true)
+	{
+		{
+			unique_lock<mutex> l(x_done);
+			doneChanged.wait_for(l, chrono::milliseconds(100), [&]() { return done.load() == count; });
+		}
+		uint32_t const d = done.load();
+		unsigned const percent = (unsigned)((uint64_t)d * 100 / count);
+		if (_progress && percent != lastPercent)
+		{
+			lastPercent = percent;
+			if (!_progress(percent))
+			{
+				abort = true;
+				break;
+			}
+		}
+		if (d == count)
+			break;
+	}
+
+	for (auto& t: workers)
+		t.join();
+	return !abort;
+}
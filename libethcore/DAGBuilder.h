@@ -0,0 +1,63 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file DAGBuilder.h
+ * Parallel generation of the full ethash dataset on the CPU.
+ */
+
+#pragma once
+
+#include <functional>
+#include <libethash/ethash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Generates a full dataset from its light cache with a pool of threads.
+ *
+ * The node range is split into chunks of @a c_chunkSize items which the threads claim
+ * one after the other, so faster cores simply take more chunks. A chunk is a whole
+ * number of cache lines, threads therefore never write to the same line.
+ */
+class DAGBuilder
+{
+public:
+	/// Called from the thread running build() with the generated percentage (0-100).
+	/// Returning false cancels the build.
+	using Progress = std::function<bool(unsigned)>;
+
+	/// Number of DAG items a thread claims at once.
+	static const uint32_t c_chunkSize = 4096;
+
+	/// @param _threads Number of generating threads, 0 for one per hardware thread.
+	explicit DAGBuilder(unsigned _threads = 0);
+
+	/// Fills every node of @a _full from @a _light. Blocks until the dataset is complete
+	/// or @a _progress asked to cancel.
+	/// @returns false if the build was cancelled; @a _full is then only partially filled.
+	bool build(ethash_full_t _full, ethash_light_t _light, Progress const& _progress = Progress()) const;
+
+	unsigned threads() const { return m_threads; }
+
+private:
+	unsigned m_threads;
+};
+
+}
+}
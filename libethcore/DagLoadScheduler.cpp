@@ -0,0 +1,133 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file DagLoadScheduler.cpp
+ * Admission control for devices generating or uploading their DAG.
+ */
+
+#include "DagLoadScheduler.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+namespace
+{
+
+// How often a waiting load checks whether it was cancelled. Admissions don't wait for
+// this; they are signalled.
+const chrono::milliseconds c_cancelCheck(200);
+
+}
+
+DagLoadScheduler::Ticket& DagLoadScheduler::Ticket::operator=(Ticket&& _other)
+{
+	if (this != &_other)
+	{
+		release();
+		swap(m_owner, _other.m_owner);
+		swap(m_hostBytes, _other.m_hostBytes);
+	}
+	return *this;
+}
+
+void DagLoadScheduler::Ticket::release()
+{
+	if (!m_owner)
+		return;
+	{
+		lock_guard<mutex> l(m_owner->x_budget);
+		--m_owner->m_loads;
+		m_owner->m_hostBytes -= m_hostBytes;
+	}
+	m_owner->m_changed.notify_all();
+	m_owner = nullptr;
+	m_hostBytes = 0;
+}
+
+DagLoadScheduler& DagLoadScheduler::get()
+{
+	static DagLoadScheduler s_scheduler;
+	return s_scheduler;
+}
+
+void DagLoadScheduler::setBudget(unsigned _loads, uint64_t _hostBytes)
+{
+	{
+		lock_guard<mutex> l(x_budget);
+		m_maxLoads = _loads;
+		m_maxHostBytes = _hostBytes;
+	}
+	m_changed.notify_all();
+}
+
+bool DagLoadScheduler::fits(uint64_t _hostBytes) const
+{
+	if (m_maxLoads && m_loads >= m_maxLoads)
+		return false;
+	return !m_maxHostBytes || !m_loads || m_hostBytes + _hostBytes <= m_maxHostBytes;
+}
+
+DagLoadScheduler::Ticket DagLoadScheduler::acquire(uint64_t _hostBytes, Cancelled const& _cancelled)
+{
+	Ticket ret;
+	unique_lock<mutex> l(x_budget);
+	uint64_t const id = m_nextId++;
+	m_queue.push_back(id);
+	while (m_queue.front() != id || !fits(_hostBytes))
+	{
+		if (_cancelled && _cancelled())
+		{
+			m_queue.erase(find(m_queue.begin(), m_queue.end(), id));
+			l.unlock();
+			// The next in line may fit now.
+			m_changed.notify_all();
+			return ret;
+		}
+		m_changed.wait_for(l, c_cancelCheck);
+	}
+	m_queue.pop_front();
+	++m_loads;
+	m_hostBytes += _hostBytes;
+	ret.m_owner = this;
+	ret.m_hostBytes = _hostBytes;
+	l.unlock();
+	m_changed.notify_all();
+	return ret;
+}
+
+bool DagLoadScheduler::waitFor(function<bool()> const& _ready, Cancelled const& _cancelled)
+{
+	unique_lock<mutex> l(x_budget);
+	while (!_ready())
+	{
+		if (_cancelled && _cancelled())
+			return false;
+		m_changed.wait_for(l, c_cancelCheck);
+	}
+	return true;
+}
+
+void DagLoadScheduler::notify(function<void()> const& _change)
+{
+	{
+		lock_guard<mutex> l(x_budget);
+		_change();
+	}
+	m_changed.notify_all();
+}
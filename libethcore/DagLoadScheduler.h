@@ -0,0 +1,103 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file DagLoadScheduler.h
+ * Admission control for devices generating or uploading their DAG.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Lets devices load their DAG in parallel up to a budget.
+ *
+ * The budget is a number of loads at once, which bounds the PCIe transfers and the host
+ * threads compiling kernels and driving them, and an amount of host memory held by the
+ * loads at once. A load waits until it fits both; waiting loads are admitted in the
+ * order they asked, and as soon as a running one finishes. A load needing more memory
+ * than the whole budget is admitted once it can run alone.
+ *
+ * Without a budget, the default, every load is admitted immediately.
+ */
+class DagLoadScheduler
+{
+public:
+	/// A load's share of the budget, given back on destruction.
+	class Ticket
+	{
+	public:
+		Ticket() = default;
+		Ticket(Ticket&& _other) { *this = std::move(_other); }
+		Ticket& operator=(Ticket&& _other);
+		~Ticket() { release(); }
+
+		explicit operator bool() const { return m_owner != nullptr; }
+		void release();
+
+	private:
+		friend class DagLoadScheduler;
+
+		DagLoadScheduler* m_owner = nullptr;
+		uint64_t m_hostBytes = 0;
+	};
+
+	/// Returns true once a waiting load should give up.
+	using Cancelled = std::function<bool()>;
+
+	static DagLoadScheduler& get();
+
+	/// At most @a _loads loads holding @a _hostBytes of host memory at once; 0 for no limit.
+	void setBudget(unsigned _loads, uint64_t _hostBytes);
+	unsigned maxLoads() const { return m_maxLoads; }
+
+	/// Waits until a load holding @a _hostBytes of host memory fits the budget.
+	/// @returns an empty ticket if @a _cancelled returned true first.
+	Ticket acquire(uint64_t _hostBytes, Cancelled const& _cancelled);
+
+	/// Waits until @a _ready returns true, e.g. for another device's load to provide
+	/// data, which is made available through notify().
+	/// @returns false if @a _cancelled returned true first.
+	bool waitFor(std::function<bool()> const& _ready, Cancelled const& _cancelled);
+	/// Makes @a _change, which may satisfy waitFor() conditions, and wakes the waiters.
+	void notify(std::function<void()> const& _change);
+
+private:
+	DagLoadScheduler() = default;
+
+	bool fits(uint64_t _hostBytes) const;
+
+	std::mutex x_budget;
+	std::condition_variable m_changed;
+	std::deque<uint64_t> m_queue;		///< Waiting loads in arrival order.
+	uint64_t m_nextId = 0;
+	unsigned m_maxLoads = 0;
+	uint64_t m_maxHostBytes = 0;
+	unsigned m_loads = 0;
+	uint64_t m_hostBytes = 0;
+};
+
+}
+}
@@ -0,0 +1,146 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file EpochPrefetcher.cpp
+ * Generates the next epoch's light cache, and optionally DAG, ahead of time.
+ */
+
+#include "EpochPrefetcher.h"
+#include "EpochRegistry.h"
+
+using namespace std;
+using namespace chrono;
+using namespace dev;
+using namespace eth;
+
+const unsigned EpochPrefetcher::c_defaultBudgetMB;
+uint64_t EpochPrefetcher::s_budget = (uint64_t)EpochPrefetcher::c_defaultBudgetMB << 20;
+
+EpochPrefetcher::~EpochPrefetcher()
+{
+	stopWorking();
+}
+
+uint64_t EpochPrefetcher::nextEpochBlock(uint64_t _block)
+{
+	return EpochRegistry::get().byBlock(_block).lastBlock + 1;
+}
+
+void EpochPrefetcher::notify(h256 const& _seed)
+{
+	if (!s_budget)
+		return;
+	DEV_GUARDED(x_seed)
+	{
+		if (_seed == m_current)
+			return;
+		m_current = _seed;
+	}
+	m_seedChanged.notify_one();
+}
+
+void EpochPrefetcher::workLoop()
+{
+	while (!shouldStop())
+	{
+		h256 current;
+		{
+			unique_lock<Mutex> l(x_seed);
+			m_seedChanged.wait_for(l, milliseconds(500));
+			if (m_current == m_handled)
+				continue;
+			current = m_current;
+		}
+
+		try
+		{
+			prefetch(current);
+		}
+		catch (std::exception const& _e)
+		{
+			cwarn << "Epoch prefetch failed: " << _e.what();
+		}
+	}
+}
+
+void EpochPrefetcher::prefetch(h256 const& _current)
+{
+	if (_current == m_next)
+	{
+		cnote << "Epoch switch: next epoch was ready"
+			<< duration_cast<seconds>(steady_clock::now() - m_nextReady).count() << "s ahead.";
+		// The miners hold their own references now.
+		m_light.reset();
+		m_full.reset();
+	}
+
+	EpochRegistry const& epochs = EpochRegistry::get();
+	uint64_t nextBlock = nextEpochBlock(EthashAux::number(_current));
+	if (nextBlock >= epochs.endBlock())
+	{
+		m_handled = _current;
+		return;
+	}
+	EpochInfo const& nextEpoch = epochs.byBlock(nextBlock);
+	h256 next = nextEpoch.seed;
+	if (next == m_next && m_light)
+	{
+		m_handled = _current;
+		return;
+	}
+
+	// Drop a prefetch for an epoch we are not heading to any more.
+	m_light.reset();
+	m_full.reset();
+	m_next = h256{1u};
+
+	uint64_t lightSize = nextEpoch.cacheSize * EthashAux::numaCopies();
+	uint64_t fullSize = nextEpoch.dagSize * EthashAux::numaCopies();
+	if (lightSize > s_budget)
+	{
+		cnote << "Not prefetching the next epoch: light cache exceeds the memory budget.";
+		m_handled = _current;
+		return;
+	}
+
+	auto start = steady_clock::now();
+	m_light = EthashAux::light(next);
+
+	bool full = m_prefetchFull && lightSize + fullSize <= s_budget;
+	if (full)
+	{
+		// Generating the next DAG would cancel a generation of the current one, so
+		// only start once the miners have theirs.
+		if (!EthashAux::full(_current))
+			return;
+		m_full = EthashAux::full(next, true, [&](unsigned)
+		{
+			Guard l(x_seed);
+			return !shouldStop() && m_current == _current;
+		});
+		// Cancelled by an epoch switch, a stop or a miner needing its own DAG first.
+		if (!m_full)
+			return;
+	}
+	else if (m_prefetchFull)
+		cnote << "Not prefetching the next DAG: it exceeds the memory budget.";
+
+	m_handled = _current;
+	m_next = next;
+	m_nextReady = steady_clock::now();
+	cnote << "Prefetched" << (full ? "light cache and DAG" : "light cache") << "for block" << nextBlock << "in"
+		<< duration_cast<milliseconds>(m_nextReady - start).count() << "ms.";
+}
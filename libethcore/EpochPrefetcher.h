@@ -0,0 +1,85 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file EpochPrefetcher.h
+ * Generates the next epoch's light cache, and optionally DAG, ahead of time.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <libdevcore/Worker.h>
+#include "EthashAux.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Prepares the epoch following the one being mined in the background.
+ *
+ * When the work switches to a new epoch, the prefetcher generates the next epoch's
+ * light cache through EthashAux and holds it, so the miners' switch at the next epoch
+ * boundary finds it ready. With setPrefetchFull() it also generates the next full
+ * dataset for the CPU miner. Nothing is prefetched that does not fit the memory budget.
+ */
+class EpochPrefetcher: public Worker
+{
+public:
+	/// Default memory budget in MB; enough for light caches but not for a DAG.
+	static const unsigned c_defaultBudgetMB = 1024;
+
+	EpochPrefetcher(): Worker("prefetch") {}
+	~EpochPrefetcher() override;
+
+	/// Memory the prefetched epoch may take, in bytes. 0 disables prefetching.
+	static void setMemoryBudget(uint64_t _bytes) { s_budget = _bytes; }
+	static uint64_t memoryBudget() { return s_budget; }
+
+	/// Whether the full dataset of the next epoch is prefetched as well.
+	void setPrefetchFull(bool _full) { m_prefetchFull = _full; }
+
+	/// Called with the seed of every work package.
+	void notify(h256 const& _seed);
+
+	/// @returns the first block of the epoch following the one containing @a _block.
+	static uint64_t nextEpochBlock(uint64_t _block);
+
+private:
+	void workLoop() override;
+
+	void prefetch(h256 const& _current);
+
+	// Epoch 0 has a zero seed hash, so h256{1u} marks "none" below.
+	Mutex x_seed;
+	std::condition_variable m_seedChanged;
+	h256 m_current = h256{1u};	///< Seed of the latest work package.
+	h256 m_handled = h256{1u};	///< Seed whose successor was last prefetched.
+
+	h256 m_next = h256{1u};		///< Seed of the prefetched epoch.
+	std::chrono::steady_clock::time_point m_nextReady;
+	EthashAux::LightType m_light;
+	EthashAux::FullType m_full;
+
+	std::atomic<bool> m_prefetchFull = {false};
+
+	static uint64_t s_budget;
+};
+
+}
+}
@@ -0,0 +1,91 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file EpochRegistry.cpp
+ * Table of all etchash epochs, indexed by block number and by seed hash.
+ */
+
+#include "EpochRegistry.h"
+#include <sstream>
+#include <stdexcept>
+#include <libdevcore/SHA3.h>
+#include <libethash/internal.h>
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+namespace
+{
+// Entries of the tabulated cache and DAG sizes in data_sizes.h.
+const unsigned c_sizedEpochs = 2048;
+}
+
+EpochRegistry const& EpochRegistry::get()
+{
+	static EpochRegistry const instance;
+	return instance;
+}
+
+EpochRegistry::EpochRegistry()
+{
+	unsigned const forkEpoch = ETCHASH_FORK_BLOCK / ETHASH_EPOCH_LENGTH;
+	unsigned const firstNewEpoch = ETCHASH_FORK_BLOCK / ETHASH_EPOCH_LENGTH_NEW;
+	static_assert(ETCHASH_FORK_BLOCK % ETHASH_EPOCH_LENGTH_NEW == 0, "the fork must start a 60000 block epoch");
+
+	// The seed chain, as long as the seed of the last 60000 block epoch needs.
+	h256s chain(2 * c_sizedEpochs - 1);
+	for (unsigned i = 1; i < chain.size(); ++i)
+		chain[i] = sha3(chain[i - 1]);
+
+	m_epochs.reserve(forkEpoch + c_sizedEpochs - firstNewEpoch);
+	for (unsigned e = 0; e < forkEpoch; ++e)
+	{
+		uint64_t first = (uint64_t)e * ETHASH_EPOCH_LENGTH;
+		m_epochs.push_back({e, chain[e], first, first + ETHASH_EPOCH_LENGTH - 1,
+			ethash_get_cachesize(first), ethash_get_datasize(first)});
+	}
+	m_forkIndex = (unsigned)m_epochs.size();
+	for (unsigned e = firstNewEpoch; e < c_sizedEpochs; ++e)
+	{
+		uint64_t first = (uint64_t)e * ETHASH_EPOCH_LENGTH_NEW;
+		m_epochs.push_back({e, chain[2 * e], first, first + ETHASH_EPOCH_LENGTH_NEW - 1,
+			ethash_get_cachesize(first), ethash_get_datasize(first)});
+	}
+
+	m_seeds.reserve(m_epochs.size());
+	for (unsigned i = 0; i < m_epochs.size(); ++i)
+		m_seeds[m_epochs[i].seed] = i;
+}
+
+EpochInfo const& EpochRegistry::byBlock(uint64_t _block) const
+{
+	if (_block >= endBlock())
+	{
+		std::ostringstream error;
+		error << "block number " << _block << " is too high; max is " << endBlock() - 1;
+		throw std::invalid_argument(error.str());
+	}
+	if (_block < ETCHASH_FORK_BLOCK)
+		return m_epochs[_block / ETHASH_EPOCH_LENGTH];
+	return m_epochs[m_forkIndex + (_block - ETCHASH_FORK_BLOCK) / ETHASH_EPOCH_LENGTH_NEW];
+}
+
+EpochInfo const* EpochRegistry::bySeed(h256 const& _seed) const
+{
+	auto it = m_seeds.find(_seed);
+	return it == m_seeds.end() ? nullptr : &m_epochs[it->second];
+}
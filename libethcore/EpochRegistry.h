@@ -0,0 +1,72 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file EpochRegistry.h
+ * Table of all etchash epochs, indexed by block number and by seed hash.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+struct EpochInfo
+{
+	unsigned epoch;			///< Epoch number, as used to index the size tables.
+	h256 seed;
+	uint64_t firstBlock;
+	uint64_t lastBlock;		///< Inclusive.
+	uint64_t cacheSize;
+	uint64_t dagSize;
+};
+
+/**
+ * @brief Every epoch of the chain, computed once on first use.
+ *
+ * Follows ECIP-1099: epochs are 30000 blocks long up to ETCHASH_FORK_BLOCK and 60000
+ * blocks long from there on. The seed of a 60000 block epoch E is the one a 30000 block
+ * epoch 2E would have, so the seeds of both halves still come from one SHA3 chain.
+ * Lookups by block or by seed are O(1).
+ */
+class EpochRegistry
+{
+public:
+	static EpochRegistry const& get();
+
+	/// @returns the epoch containing @a _block. Throws for blocks past the last epoch.
+	EpochInfo const& byBlock(uint64_t _block) const;
+	/// @returns the epoch with the given seed hash, or null if there is none.
+	EpochInfo const* bySeed(h256 const& _seed) const;
+
+	/// @returns the block following the last block of the table.
+	uint64_t endBlock() const { return m_epochs.back().lastBlock + 1; }
+
+private:
+	EpochRegistry();
+
+	std::vector<EpochInfo> m_epochs;
+	std::unordered_map<h256, unsigned> m_seeds;	///< Seed hash to index in m_epochs.
+	unsigned m_forkIndex;						///< Index of the first 60000 block epoch.
+};
+
+}
+}
@@ -0,0 +1,427 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file EpochShare.cpp
+ * Epoch data shared between etcminer processes through POSIX shared memory.
+ */
+
+#include "EpochShare.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <libdevcore/Log.h>
+#include <libdevcore/Memory.h>
+
+#if defined(__linux__)
+#define ETH_EPOCH_SHARE 1
+#include <climits>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace chrono;
+using namespace dev;
+using namespace eth;
+
+namespace
+{
+
+// Bump when the layout of the header or the data changes.
+const uint32_t c_version = 2;
+const char c_magic[8] = {'E', 'T', 'C', 'S', 'H', 'A', 'R', 'E'};
+// The data starts at this offset, so it is page aligned once mapped.
+const size_t c_headerSize = 4096;
+// How long a process waits for the creator of a segment to set it up.
+const seconds c_setupTimeout = seconds(5);
+
+enum State: uint32_t
+{
+	Initialising = 0,	///< Created but not set up yet; the segment starts zeroed.
+	Building,
+	Ready,
+	Failed				///< Unlinked already, holders only unmap it.
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory atomics must be lock free");
+
+struct SegmentHeader
+{
+	atomic<uint32_t> state;	///< A State, also the futex word waited on.
+	int32_t builder;		///< Pid of the process generating the data.
+	uint32_t version;
+	char magic[8];
+	uint64_t firstBlock;
+	uint64_t size;
+	uint8_t seed[32];
+};
+
+atomic<bool> s_enabled = {false};
+
+char const* kindName(EpochShare::Kind _kind)
+{
+	return _kind == EpochShare::Kind::Light ? "light" : "dag";
+}
+
+char const* description(EpochShare::Kind _kind)
+{
+	return _kind == EpochShare::Kind::Light ? "light cache" : "host DAG";
+}
+
+#if ETH_EPOCH_SHARE
+
+void futexWait(atomic<uint32_t>& _word, uint32_t _value, long _ms)
+{
+	timespec timeout = {_ms / 1000, (_ms % 1000) * 1000000};
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_word), FUTEX_WAIT, _value, &timeout, nullptr, 0);
+}
+
+void futexWakeAll(atomic<uint32_t>& _word)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+/// The creator of a segment holds an exclusive lock on it until the data is ready or
+/// failed, and then a shared one like every process using the data. The locks go with
+/// the processes, so a free lock on a segment that is not ready means its creator died,
+/// and a segment that can be locked exclusively is unused.
+bool creatorGone(int _fd)
+{
+	if (flock(_fd, LOCK_SH | LOCK_NB) != 0)
+		return false;
+	flock(_fd, LOCK_UN);
+	return true;
+}
+
+/// Whether the segment open as @a _fd is still the one named @a _name, rather than
+/// removed and possibly replaced by a new one.
+bool isNamed(int _fd, string const& _name)
+{
+	struct stat opened;
+	struct stat named;
+	return fstat(_fd, &opened) == 0 && stat(("/dev/shm" + _name).c_str(), &named) == 0 &&
+		opened.st_dev == named.st_dev && opened.st_ino == named.st_ino;
+}
+
+/// Removes this user's segments other than @a _keep that no process holds, such as those
+/// of earlier epochs whose last holder was killed.
+void removeUnused(string const& _keep)
+{
+	string const prefix = "etcminer-" + to_string(getuid()) + "-";
+	DIR* dir = opendir("/dev/shm");
+	if (!dir)
+		return;
+	while (dirent* entry = readdir(dir))
+	{
+		string const name = string("/") + entry->d_name;
+		if (name.compare(1, prefix.size(), prefix) != 0 || name == _keep)
+			continue;
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			continue;
+		// An empty segment may be one its creator has not locked yet.
+		struct stat st;
+		if (flock(fd, LOCK_EX | LOCK_NB) == 0 && fstat(fd, &st) == 0 && st.st_size != 0 && isNamed(fd, name))
+		{
+			cnote << "Removing unused shared memory" << name;
+			shm_unlink(name.c_str());
+		}
+		close(fd);
+	}
+	closedir(dir);
+}
+
+#endif
+
+}
+
+EpochShare::Segment& EpochShare::Segment::operator=(Segment&& _other)
+{
+	if (this != &_other)
+	{
+		reset();
+		swap(m_header, _other.m_header);
+		swap(m_data, _other.m_data);
+		swap(m_size, _other.m_size);
+		swap(m_name, _other.m_name);
+		swap(m_fd, _other.m_fd);
+	}
+	return *this;
+}
+
+void EpochShare::Segment::reset()
+{
+#if ETH_EPOCH_SHARE
+	if (m_header)
+	{
+		munmap(m_data, m_size);
+		SegmentHeader* header = (SegmentHeader*)m_header;
+		// Remove the segment if no other process holds it. A failed segment was unlinked
+		// when it failed; its name may have a new owner.
+		if (header->state.load() == Ready && flock(m_fd, LOCK_EX | LOCK_NB) == 0 && isNamed(m_fd, m_name))
+			shm_unlink(m_name.c_str());
+		munmap(m_header, c_headerSize);
+		close(m_fd);
+	}
+#endif
+	m_header = m_data = nullptr;
+	m_fd = -1;
+	m_size = 0;
+	m_name.clear();
+}
+
+void EpochShare::setEnabled(bool _enabled)
+{
+#if !ETH_EPOCH_SHARE
+	if (_enabled)
+	{
+		cwarn << "Sharing epoch data between processes is not supported on this platform.";
+		return;
+	}
+#endif
+	s_enabled = _enabled;
+}
+
+bool EpochShare::enabled()
+{
+	return s_enabled;
+}
+
+EpochShare::Segment EpochShare::acquire(Kind _kind, EpochInfo const& _epoch, uint64_t _size, Builder const& _build)
+{
+#if ETH_EPOCH_SHARE
+	if (!enabled())
+		return Segment();
+	string const name = "/etcminer-" + to_string(getuid()) + "-" + kindName(_kind) + "-" + to_string(_epoch.firstBlock);
+	removeUnused(name);
+	// A second round only follows a segment whose creator failed.
+	for (unsigned round = 0; round < 2; ++round)
+	{
+		int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd >= 0)
+		{
+			flock(fd, LOCK_EX);
+			Segment ret = create(fd, name, _epoch, _size, _build);
+			if (ret)
+				cnote << "Sharing" << description(_kind) << "for block" << _epoch.firstBlock << "with other processes.";
+			return ret;
+		}
+		if (errno != EEXIST || (fd = shm_open(name.c_str(), O_RDWR, 0)) < 0)
+		{
+			cwarn << "Can't open shared memory" << name << ":" << strerror(errno);
+			return Segment();
+		}
+		bool retry;
+		Segment ret = attach(fd, name, _epoch, _size, retry);
+		if (ret)
+		{
+			cnote << "Using" << description(_kind) << "for block" << _epoch.firstBlock << "shared by process"
+				<< ((SegmentHeader*)ret.m_header)->builder;
+			return ret;
+		}
+		if (!retry)
+			break;
+	}
+#else
+	(void)_kind;
+	(void)_epoch;
+	(void)_size;
+	(void)_build;
+#endif
+	return Segment();
+}
+
+EpochShare::Segment EpochShare::create(int _fd, string const& _name, EpochInfo const& _epoch, uint64_t _size, Builder const& _build)
+{
+	Segment ret;
+#if ETH_EPOCH_SHARE
+	// Reserve the memory now; running out of it later would be a SIGBUS.
+	int error = ftruncate(_fd, c_headerSize + _size) == 0 ? posix_fallocate(_fd, 0, c_headerSize + _size) : errno;
+	void* header = MAP_FAILED;
+	void* data = MAP_FAILED;
+	if (!error)
+	{
+		header = mmap(nullptr, c_headerSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+		data = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, c_headerSize);
+		if (header == MAP_FAILED || data == MAP_FAILED)
+			error = errno;
+	}
+	if (error)
+	{
+		cwarn << "Can't allocate shared memory" << _name << ":" << strerror(error);
+		if (header != MAP_FAILED)
+			munmap(header, c_headerSize);
+		if (data != MAP_FAILED)
+			munmap(data, _size);
+		shm_unlink(_name.c_str());
+		close(_fd);
+		return ret;
+	}
+
+	SegmentHeader* h = (SegmentHeader*)header;
+	memcpy(h->magic, c_magic, sizeof(c_magic));
+	h->version = c_version;
+	h->firstBlock = _epoch.firstBlock;
+	h->size = _size;
+	memcpy(h->seed, _epoch.seed.data(), sizeof(h->seed));
+	h->builder = getpid();
+	LargeBuffer::lock(data, _size);
+	h->state = Building;
+	futexWakeAll(h->state);
+
+	ret.m_header = header;
+	ret.m_data = data;
+	ret.m_size = _size;
+	ret.m_name = _name;
+	ret.m_fd = _fd;
+
+	auto fail = [&]()
+	{
+		h->state = Failed;
+		futexWakeAll(h->state);
+		shm_unlink(_name.c_str());
+		ret.reset();
+	};
+	try
+	{
+		if (!_build(data))
+		{
+			fail();
+			return ret;
+		}
+	}
+	catch (...)
+	{
+		fail();
+		throw;
+	}
+	mprotect(data, _size, PROT_READ);
+	// Ready before the lock is downgraded: a waiter finding only a shared lock on a
+	// Building segment takes its creator for dead. Waiters block in flock(LOCK_SH) until
+	// the downgrade, which on Linux doesn't release the lock in between.
+	uint32_t building = Building;
+	if (!h->state.compare_exchange_strong(building, Ready))
+	{
+		// Taken for dead by a waiter anyway, which removed the segment.
+		ret.reset();
+		return ret;
+	}
+	futexWakeAll(h->state);
+	flock(_fd, LOCK_SH);
+#else
+	(void)_fd;
+	(void)_name;
+	(void)_epoch;
+	(void)_size;
+	(void)_build;
+#endif
+	return ret;
+}
+
+EpochShare::Segment EpochShare::attach(int _fd, string const& _name, EpochInfo const& _epoch, uint64_t _size, bool& o_retry)
+{
+	Segment ret;
+	o_retry = false;
+#if ETH_EPOCH_SHARE
+	void* header = MAP_FAILED;
+	void* data = MAP_FAILED;
+	auto giveUp = [&](char const* _why)
+	{
+		if (header != MAP_FAILED)
+			munmap(header, c_headerSize);
+		if (data != MAP_FAILED)
+			munmap(data, _size);
+		// Left behind by a creator that died before setting it up?
+		if (!_why && creatorGone(_fd))
+		{
+			if (isNamed(_fd, _name))
+				shm_unlink(_name.c_str());
+			o_retry = true;
+		}
+		else if (_why)
+			cwarn << "Shared memory" << _name << _why;
+		close(_fd);
+		return Segment();
+	};
+
+	// The creator sizes the segment and then fills in its header.
+	auto deadline = steady_clock::now() + c_setupTimeout;
+	struct stat st;
+	while (fstat(_fd, &st) == 0 && (uint64_t)st.st_size < c_headerSize + _size && steady_clock::now() < deadline)
+		this_thread::sleep_for(milliseconds(1));
+	if ((uint64_t)st.st_size != c_headerSize + _size)
+		return giveUp((uint64_t)st.st_size > c_headerSize + _size ? "has an unexpected size." : nullptr);
+	header = mmap(nullptr, c_headerSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, c_headerSize);
+	if (header == MAP_FAILED || data == MAP_FAILED)
+		return giveUp("can't be mapped.");
+	SegmentHeader* h = (SegmentHeader*)header;
+	while (h->state == Initialising && steady_clock::now() < deadline)
+		this_thread::sleep_for(milliseconds(1));
+	if (h->state == Initialising)
+		return giveUp(nullptr);
+	if (memcmp(h->magic, c_magic, sizeof(c_magic)) != 0 || h->version != c_version || h->firstBlock != _epoch.firstBlock ||
+		h->size != _size || memcmp(h->seed, _epoch.seed.data(), sizeof(h->seed)) != 0)
+		// Possibly another etcminer version's; leave it alone.
+		return giveUp("is not usable.");
+
+	ret.m_header = header;
+	ret.m_data = data;
+	ret.m_size = _size;
+	ret.m_name = _name;
+	ret.m_fd = _fd;
+
+	uint32_t state;
+	while ((state = h->state) == Building)
+	{
+		futexWait(h->state, Building, 1000);
+		uint32_t building = Building;
+		if (h->state == Building && creatorGone(_fd) && h->state.compare_exchange_strong(building, Failed))
+		{
+			cwarn << "Process" << h->builder << "died while generating" << _name;
+			futexWakeAll(h->state);
+			if (isNamed(_fd, _name))
+				shm_unlink(_name.c_str());
+		}
+	}
+	// Holding the lock keeps other processes from removing the segment. A last holder
+	// removing it right now leaves this process the only user of the data, still valid.
+	if (state == Ready)
+	{
+		flock(_fd, LOCK_SH);
+		LargeBuffer::lock(data, _size);
+	}
+	else
+	{
+		ret.reset();
+		o_retry = true;
+	}
+#else
+	(void)_fd;
+	(void)_name;
+	(void)_epoch;
+	(void)_size;
+#endif
+	return ret;
+}
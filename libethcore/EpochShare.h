@@ -0,0 +1,97 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file EpochShare.h
+ * Epoch data shared between etcminer processes through POSIX shared memory.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include "EpochRegistry.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Lets several etcminer processes on one host use one copy of an epoch's data.
+ *
+ * Each piece of data lives in a POSIX shared memory segment named after its kind and
+ * epoch. The first process to ask for it creates the segment and generates the data;
+ * the others map it read-only and sleep on a futex until the data is ready. Each process
+ * using a segment holds a shared flock() on it, which the kernel drops if the process
+ * dies; the last one to let go removes the segment, and acquire() removes the ones no
+ * process holds any more. If the generating process dies, the waiting ones notice,
+ * remove the segment and generate the data themselves.
+ *
+ * Sharing is disabled by default and only available on Linux.
+ */
+class EpochShare
+{
+public:
+	enum class Kind
+	{
+		Light,
+		HostDag
+	};
+
+	/// One process' reference to a ready segment; released on destruction.
+	class Segment
+	{
+	public:
+		Segment() = default;
+		Segment(Segment&& _other) { *this = std::move(_other); }
+		Segment& operator=(Segment&& _other);
+		~Segment() { reset(); }
+
+		void const* data() const { return m_data; }
+		explicit operator bool() const { return m_data != nullptr; }
+		void reset();
+
+	private:
+		friend class EpochShare;
+
+		void* m_header = nullptr;
+		void* m_data = nullptr;
+		uint64_t m_size = 0;
+		std::string m_name;
+		int m_fd = -1;				///< Kept open with a shared lock while the segment is held.
+	};
+
+	/// Fills the @a _data of a new segment. Returns false on failure.
+	using Builder = std::function<bool(void* _data)>;
+
+	static void setEnabled(bool _enabled);
+	static bool enabled();
+
+	/// @returns the segment of @a _kind for @a _epoch, calling @a _build to fill it if this
+	/// process creates it. An empty segment is returned if sharing is disabled or failed,
+	/// in which case the caller should generate the data on its own.
+	static Segment acquire(Kind _kind, EpochInfo const& _epoch, uint64_t _size, Builder const& _build);
+
+private:
+	/// Sizes and fills the segment this process just created as @a _fd.
+	static Segment create(int _fd, std::string const& _name, EpochInfo const& _epoch, uint64_t _size, Builder const& _build);
+	/// Maps the segment another process created and waits for its data. Sets @a o_retry
+	/// if the segment failed and was removed, so that a new one may be created.
+	static Segment attach(int _fd, std::string const& _name, EpochInfo const& _epoch, uint64_t _size, bool& o_retry);
+};
+
+}
+}
@@ -0,0 +1,345 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file EpochStore.cpp
+ * On-disk store of generated light caches and full datasets.
+ */
+
+#include "EpochStore.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <libdevcore/Guards.h>
+#include <libdevcore/Log.h>
+#include <libdevcore/Memory.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#define ETH_EPOCH_STORE 1
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace chrono;
+using namespace dev;
+using namespace eth;
+
+const unsigned EpochStore::c_defaultKeep;
+
+namespace
+{
+
+// Bump when the layout of the header or the data changes; older files are then discarded.
+const uint32_t c_version = 1;
+const char c_magic[8] = {'E', 'T', 'C', 'E', 'P', 'O', 'C', 'H'};
+// The data starts at this offset, so it is aligned for the hash kernels once mapped.
+const size_t c_headerSize = 4096;
+
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t kind;
+	uint64_t firstBlock;
+	uint64_t size;		///< Bytes of data following the header.
+	uint8_t seed[32];
+	uint64_t checksum;	///< Of the data.
+};
+
+Mutex x_store;
+string s_dir;
+unsigned s_keep = EpochStore::c_defaultKeep;
+
+char const* kindName(EpochStore::Kind _kind)
+{
+	return _kind == EpochStore::Kind::Light ? "light" : "full";
+}
+
+inline uint64_t rotl(uint64_t _x, unsigned _r)
+{
+	return (_x << _r) | (_x >> (64 - _r));
+}
+
+/// Fast non-cryptographic checksum, good enough to detect truncated or damaged files.
+/// Four independent lanes keep it close to memory bandwidth. @a _size is a multiple of 32.
+uint64_t checksum(void const* _data, uint64_t _size)
+{
+	uint64_t const p1 = 0x9e3779b185ebca87ULL;
+	uint64_t const p2 = 0xc2b2ae3d27d4eb4fULL;
+	uint64_t lanes[4] = {p1 + p2, p2, 0, 0 - p1};
+	uint64_t const* words = (uint64_t const*)_data;
+	for (uint64_t i = 0; i + 4 <= _size / 8; i += 4)
+		for (unsigned l = 0; l < 4; ++l)
+			lanes[l] = rotl(lanes[l] + words[i + l] * p2, 31) * p1;
+	uint64_t ret = _size;
+	for (unsigned l = 0; l < 4; ++l)
+		ret = (ret ^ rotl(lanes[l] * p2, 31) * p1) * p1 + p2;
+	return ret;
+}
+
+#if ETH_EPOCH_STORE
+
+bool makeDirectories(string const& _dir)
+{
+	for (size_t pos = 1; pos <= _dir.size(); ++pos)
+		if (pos == _dir.size() || _dir[pos] == '/')
+		{
+			string part = _dir.substr(0, pos);
+			if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST)
+				return false;
+		}
+	return true;
+}
+
+bool writeAll(int _fd, void const* _data, uint64_t _size)
+{
+	char const* p = (char const*)_data;
+	while (_size)
+	{
+		ssize_t n = ::write(_fd, p, (size_t)min<uint64_t>(_size, 1 << 30));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		_size -= n;
+	}
+	return true;
+}
+
+#endif
+
+}
+
+EpochStore::Mapping& EpochStore::Mapping::operator=(Mapping&& _other)
+{
+	if (this != &_other)
+	{
+		reset();
+		swap(m_base, _other.m_base);
+		swap(m_length, _other.m_length);
+		swap(m_data, _other.m_data);
+	}
+	return *this;
+}
+
+void EpochStore::Mapping::reset()
+{
+#if ETH_EPOCH_STORE
+	if (m_base)
+		munmap(m_base, m_length);
+#endif
+	m_base = m_data = nullptr;
+	m_length = 0;
+}
+
+string EpochStore::defaultDirectory()
+{
+	char const* home = getenv("HOME");
+	return string(home ? home : ".") + "/.etcminer/dag";
+}
+
+void EpochStore::setDirectory(string const& _dir)
+{
+#if !ETH_EPOCH_STORE
+	if (!_dir.empty())
+	{
+		cwarn << "The DAG store is not supported on this platform.";
+		return;
+	}
+#endif
+	Guard l(x_store);
+	s_dir = _dir;
+	while (s_dir.size() > 1 && s_dir.back() == '/')
+		s_dir.pop_back();
+}
+
+string EpochStore::directory()
+{
+	Guard l(x_store);
+	return s_dir;
+}
+
+void EpochStore::setKeep(unsigned _epochs)
+{
+	Guard l(x_store);
+	s_keep = max(_epochs, 1u);
+}
+
+string EpochStore::path(Kind _kind, EpochInfo const& _epoch)
+{
+	return directory() + "/" + kindName(_kind) + "-" + to_string(_epoch.firstBlock);
+}
+
+EpochStore::Mapping EpochStore::load(Kind _kind, EpochInfo const& _epoch)
+{
+	Mapping ret;
+#if ETH_EPOCH_STORE
+	if (directory().empty())
+		return ret;
+	string const file = path(_kind, _epoch);
+	uint64_t const size = _kind == Kind::Light ? _epoch.cacheSize : _epoch.dagSize;
+
+	int fd = open(file.c_str(), O_RDONLY);
+	if (fd < 0)
+		return ret;
+	auto start = steady_clock::now();
+	FileHeader header;
+	struct stat st;
+	bool valid = fstat(fd, &st) == 0 && (uint64_t)st.st_size == c_headerSize + size &&
+		pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+		memcmp(header.magic, c_magic, sizeof(c_magic)) == 0 && header.version == c_version &&
+		header.kind == (uint32_t)_kind && header.firstBlock == _epoch.firstBlock &&
+		header.size == size && memcmp(header.seed, _epoch.seed.data(), sizeof(header.seed)) == 0;
+	if (valid)
+	{
+		int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+		// Read the whole file in now rather than page by page while hashing.
+		flags |= MAP_POPULATE;
+#endif
+		void* base = mmap(nullptr, c_headerSize + size, PROT_READ, flags, fd, 0);
+		if (base != MAP_FAILED)
+		{
+			ret.m_base = base;
+			ret.m_length = c_headerSize + size;
+			ret.m_data = (char*)base + c_headerSize;
+			valid = checksum(ret.m_data, size) == header.checksum;
+		}
+		else
+		{
+			cwarn << "Can't map" << file << ":" << strerror(errno);
+			close(fd);
+			return ret;
+		}
+	}
+	close(fd);
+
+	if (!valid)
+	{
+		cwarn << "Discarding damaged or outdated" << file;
+		ret.reset();
+		unlink(file.c_str());
+		return ret;
+	}
+	// A private file mapping would otherwise be read back from disk once evicted.
+	LargeBuffer::lock(ret.m_data, size);
+	cnote << "Loaded" << (_kind == Kind::Light ? "light cache" : "DAG") << "for block" << _epoch.firstBlock << "from disk in"
+		<< duration_cast<milliseconds>(steady_clock::now() - start).count() << "ms.";
+#else
+	(void)_kind;
+	(void)_epoch;
+#endif
+	return ret;
+}
+
+void EpochStore::save(Kind _kind, EpochInfo const& _epoch, void const* _data, uint64_t _size)
+{
+#if ETH_EPOCH_STORE
+	string const dir = directory();
+	if (dir.empty())
+		return;
+	if (!makeDirectories(dir))
+	{
+		cwarn << "Can't create" << dir << ":" << strerror(errno);
+		return;
+	}
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, c_magic, sizeof(c_magic));
+	header.version = c_version;
+	header.kind = (uint32_t)_kind;
+	header.firstBlock = _epoch.firstBlock;
+	header.size = _size;
+	memcpy(header.seed, _epoch.seed.data(), sizeof(header.seed));
+	header.checksum = checksum(_data, _size);
+	vector<char> page(c_headerSize, 0);
+	memcpy(page.data(), &header, sizeof(header));
+
+	// Written under a temporary name and renamed, so no reader sees a partial file.
+	string const file = path(_kind, _epoch);
+	string const temp = file + ".tmp" + to_string(getpid());
+	int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		cwarn << "Can't write" << temp << ":" << strerror(errno);
+		return;
+	}
+	bool written = writeAll(fd, page.data(), page.size()) && writeAll(fd, _data, _size);
+	written = close(fd) == 0 && written;
+	if (!written || rename(temp.c_str(), file.c_str()) != 0)
+	{
+		cwarn << "Can't write" << file << ":" << strerror(errno);
+		unlink(temp.c_str());
+		return;
+	}
+	collectGarbage(dir);
+#else
+	(void)_kind;
+	(void)_epoch;
+	(void)_data;
+	(void)_size;
+#endif
+}
+
+void EpochStore::collectGarbage(string const& _dir)
+{
+#if ETH_EPOCH_STORE
+	DIR* d = opendir(_dir.c_str());
+	if (!d)
+		return;
+	// Files are named <kind>-<first block>; anything else is not ours.
+	Guard l(x_store);
+	vector<pair<uint64_t, string>> files;
+	set<uint64_t> epochs;
+	while (dirent* e = readdir(d))
+	{
+		string name = e->d_name;
+		size_t dash = name.find('-');
+		if (dash == string::npos || dash + 1 == name.size())
+			continue;
+		string kind = name.substr(0, dash);
+		string block = name.substr(dash + 1);
+		if ((kind != kindName(Kind::Light) && kind != kindName(Kind::Full)) ||
+			block.find_first_not_of("0123456789") != string::npos)
+			continue;
+		uint64_t firstBlock = strtoull(block.c_str(), nullptr, 10);
+		files.emplace_back(firstBlock, name);
+		epochs.insert(firstBlock);
+	}
+	closedir(d);
+
+	unsigned keep = s_keep;
+	if (epochs.size() <= keep)
+		return;
+	uint64_t oldestKept = *next(epochs.rbegin(), keep - 1);
+	for (auto const& f: files)
+		if (f.first < oldestKept)
+		{
+			cnote << "Removing" << f.second << "from the DAG store.";
+			unlink((_dir + "/" + f.second).c_str());
+		}
+#else
+	(void)_dir;
+#endif
+}
@@ -0,0 +1,96 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file EpochStore.h
+ * On-disk store of generated light caches and full datasets.
+ */
+
+#pragma once
+
+#include <string>
+#include "EpochRegistry.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Keeps light caches and full datasets on disk so restarts don't regenerate them.
+ *
+ * Each artifact is one file in the store directory, named after its kind and the first
+ * block of its epoch. A page sized header holding a format version, the epoch's seed
+ * hash and size and a checksum of the data precedes the data, which is mapped read-only
+ * when loaded. Files that don't match the epoch or fail the checksum are deleted. Only
+ * the artifacts of the most recent epochs are kept.
+ *
+ * The store is disabled until a directory is set. It is only available on POSIX systems.
+ */
+class EpochStore
+{
+public:
+	enum class Kind
+	{
+		Light,
+		Full
+	};
+
+	/// A loaded artifact. The data stays mapped until this is destroyed.
+	class Mapping
+	{
+	public:
+		Mapping() = default;
+		Mapping(Mapping&& _other) { *this = std::move(_other); }
+		Mapping& operator=(Mapping&& _other);
+		~Mapping() { reset(); }
+
+		void* data() const { return m_data; }
+		explicit operator bool() const { return m_data != nullptr; }
+
+	private:
+		friend class EpochStore;
+		void reset();
+
+		void* m_base = nullptr;
+		size_t m_length = 0;
+		void* m_data = nullptr;
+	};
+
+	/// Number of epochs whose artifacts are kept by default.
+	static const unsigned c_defaultKeep = 2;
+
+	/// @returns ~/.etcminer/dag.
+	static std::string defaultDirectory();
+
+	/// Enables the store in @a _dir, which is created when needed. Empty disables it.
+	static void setDirectory(std::string const& _dir);
+	static std::string directory();
+	/// Artifacts of the @a _epochs most recent epochs are kept; older ones are deleted.
+	static void setKeep(unsigned _epochs);
+
+	/// @returns the mapped artifact of @a _epoch, or an empty mapping if the store is
+	/// disabled or holds no valid one.
+	static Mapping load(Kind _kind, EpochInfo const& _epoch);
+	/// Writes an artifact of @a _epoch to the store. Failures are logged and ignored.
+	static void save(Kind _kind, EpochInfo const& _epoch, void const* _data, uint64_t _size);
+
+private:
+	static std::string path(Kind _kind, EpochInfo const& _epoch);
+	static void collectGarbage(std::string const& _dir);
+};
+
+}
+}
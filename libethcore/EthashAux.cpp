@@ -20,6 +20,10 @@
  */
 
 #include "EthashAux.h"
+#include <cstring>
+#include <thread>
+#include "EpochRegistry.h"
+#include <libdevcore/Numa.h>
 #include <libethash/internal.h>
 
 using namespace std;
@@ -27,6 +31,53 @@ using namespace chrono;
 using namespace dev;
 using namespace eth;
 
+const unsigned EthashAux::c_defaultLightCacheCapacity;
+
+namespace
+{
+
+string describe(LargeBuffer const& _buffer)
+{
+	return string(toString(_buffer.tier())) + (_buffer.locked() ? ", locked" : "");
+}
+
+/// Copies the @a _size bytes at @a _data to each NUMA node, each copy by a thread running
+/// on its node so its pages are local even if they can't be bound. If @a _movable, the
+/// data is moved to the first node rather than copied there. Nodes that got no copy,
+/// including the first if @a _movable, are left empty and use @a _data.
+vector<LargeBuffer> replicate(void* _data, uint64_t _size, bool _movable, char const* _what, uint64_t _block)
+{
+	auto start = steady_clock::now();
+	unsigned const nodes = (unsigned)Numa::nodes().size();
+	vector<LargeBuffer> ret(nodes);
+	if (_movable && !Numa::bindMemory(_data, _size, 0))
+		_movable = false;
+	vector<thread> copiers;
+	for (unsigned n = _movable ? 1 : 0; n < nodes; ++n)
+		copiers.emplace_back([&, n]()
+		{
+			Numa::pinThread(n);
+			LargeBuffer copy = LargeBuffer::allocate(_size);
+			if (!copy)
+				return;
+			Numa::bindMemory(copy.data(), _size, n);
+			memcpy(copy.data(), _data, _size);
+			ret[n] = move(copy);
+		});
+	for (auto& t: copiers)
+		t.join();
+	unsigned copied = 0;
+	for (auto const& c: ret)
+		copied += c ? 1 : 0;
+	if (copied + (_movable ? 1 : 0) < nodes)
+		cwarn << "Out of memory copying the" << _what << "for block" << _block << "to every NUMA node.";
+	cnote << "Copied" << _what << "for block" << _block << "to" << copied << "NUMA nodes in"
+		<< duration_cast<milliseconds>(steady_clock::now() - start).count() << "ms.";
+	return ret;
+}
+
+}
+
 EthashAux& EthashAux::get()
 {
 	static EthashAux instance;
@@ -35,71 +86,253 @@ EthashAux& EthashAux::get()
 
 h256 EthashAux::seedHash(unsigned _number)
 {
-	unsigned epoch = _number / ETHASH_EPOCH_LENGTH;
-	EthashAux& ethash = EthashAux::get();
-	Guard l(ethash.x_epochs);
-	if (epoch >= ethash.m_seedHashes.size())
+	return EpochRegistry::get().byBlock(_number).seed;
+}
+
+uint64_t EthashAux::number(h256 const& _seedHash)
+{
+	EpochInfo const* epoch = EpochRegistry::get().bySeed(_seedHash);
+	if (!epoch)
 	{
-		h256 ret;
-		unsigned n = 0;
-		if (!ethash.m_seedHashes.empty())
-		{
-			ret = ethash.m_seedHashes.back();
-			n = ethash.m_seedHashes.size() - 1;
-		}
-		ethash.m_seedHashes.resize(epoch + 1);
-		for (; n <= epoch; ++n, ret = sha3(ret))
-			ethash.m_seedHashes[n] = ret;
+		std::ostringstream error;
+		error << "no epoch has the seed hash " << _seedHash;
+		throw std::invalid_argument(error.str());
 	}
-	return ethash.m_seedHashes[epoch];
+	return epoch->firstBlock;
 }
 
-uint64_t EthashAux::number(h256 const& _seedHash)
+EthashAux::LightType EthashAux::light(h256 const& _seedHash)
 {
+	// TODO: Use epoch number instead of seed hash?
+
 	EthashAux& ethash = EthashAux::get();
-	Guard l(ethash.x_epochs);
-	unsigned epoch = 0;
-	auto epochIter = ethash.m_epochs.find(_seedHash);
-	if (epochIter == ethash.m_epochs.end())
+	shared_future<LightType> ret;
+	promise<LightType> build;
+	uint64_t buildId = 0;
+	DEV_GUARDED(ethash.x_lights)
 	{
-		for (h256 h; h != _seedHash && epoch < 2048; ++epoch, h = sha3(h), ethash.m_epochs[h] = epoch) {}
-		if (epoch == 2048)
+		auto it = ethash.m_lights.find(_seedHash);
+		if (it != ethash.m_lights.end())
+		{
+			// Either ready or being generated by another thread, which we then wait for.
+			ethash.m_lightStats.hits++;
+			ethash.m_lightsLRU.splice(ethash.m_lightsLRU.begin(), ethash.m_lightsLRU, it->second);
+			ret = it->second->light;
+		}
+		else
 		{
-			std::ostringstream error;
-			error << "apparent block number for " << _seedHash << " is too high; max is " << (ETHASH_EPOCH_LENGTH * 2048);
-			throw std::invalid_argument(error.str());
+			auto evicted = ethash.m_evictedLights.find(_seedHash);
+			LightType held = evicted != ethash.m_evictedLights.end() ? evicted->second.lock() : LightType();
+			if (held)
+			{
+				ethash.m_lightStats.hits++;
+				build.set_value(held);
+				ethash.insertLight(_seedHash, build.get_future().share(), ++ethash.m_lightIds);
+				return held;
+			}
+			ethash.m_lightStats.misses++;
+			ret = build.get_future().share();
+			buildId = ++ethash.m_lightIds;
+			ethash.insertLight(_seedHash, ret, buildId);
 		}
 	}
-	else
-		epoch = epochIter->second;
-	return epoch * ETHASH_EPOCH_LENGTH;
+	if (!buildId)
+		return ret.get();
+
+	// We are the first to ask for this epoch: generate it without holding x_lights.
+	try
+	{
+		auto start = steady_clock::now();
+		LightType light = make_shared<LightAllocation>(_seedHash);
+		auto buildMs = duration_cast<milliseconds>(steady_clock::now() - start).count();
+		cnote << "Light cache for block" << light->light->block_number << "ready in" << buildMs << "ms.";
+		DEV_GUARDED(ethash.x_lights)
+			ethash.m_lightStats.buildMs += buildMs;
+		build.set_value(light);
+	}
+	catch (...)
+	{
+		// Don't cache the failure; the next caller tries again.
+		DEV_GUARDED(ethash.x_lights)
+		{
+			auto it = ethash.m_lights.find(_seedHash);
+			if (it != ethash.m_lights.end() && it->second->id == buildId)
+			{
+				ethash.m_lightsLRU.erase(it->second);
+				ethash.m_lights.erase(it);
+			}
+		}
+		build.set_exception(current_exception());
+	}
+	return ret.get();
 }
 
-EthashAux::LightType EthashAux::light(h256 const& _seedHash)
+void EthashAux::insertLight(h256 const& _seedHash, shared_future<LightType> const& _light, uint64_t _id)
 {
-	// TODO: Use epoch number instead of seed hash?
+	m_evictedLights.erase(_seedHash);
+	m_lightsLRU.push_front(LightEntry{_seedHash, _light, _id});
+	m_lights[_seedHash] = m_lightsLRU.begin();
+	evictLights();
+}
 
+void EthashAux::evictLights()
+{
+	while (m_lightsLRU.size() > m_lightCapacity)
+	{
+		LightEntry const& e = m_lightsLRU.back();
+		// Failed builds are dropped before their future is set, ready ones hold a cache.
+		if (e.light.wait_for(seconds(0)) == future_status::ready)
+			m_evictedLights[e.seed] = e.light.get();
+		m_lights.erase(e.seed);
+		m_lightsLRU.pop_back();
+		m_lightStats.evictions++;
+	}
+	for (auto it = m_evictedLights.begin(); it != m_evictedLights.end();)
+		it = it->second.expired() ? m_evictedLights.erase(it) : next(it);
+}
+
+void EthashAux::setLightCacheCapacity(unsigned _capacity)
+{
 	EthashAux& ethash = EthashAux::get();
 	Guard l(ethash.x_lights);
-	if (ethash.m_lights.count(_seedHash))
-		return ethash.m_lights.at(_seedHash);
-	return (ethash.m_lights[_seedHash] = make_shared<LightAllocation>(_seedHash));
+	ethash.m_lightCapacity = max(_capacity, 1u);
+	ethash.evictLights();
+}
+
+EthashAux::LightCacheStats EthashAux::lightCacheStats()
+{
+	EthashAux& ethash = EthashAux::get();
+	Guard l(ethash.x_lights);
+	LightCacheStats ret = ethash.m_lightStats;
+	ret.size = (unsigned)ethash.m_lightsLRU.size();
+	for (auto const& e: ethash.m_lightsLRU)
+	{
+		// Failed builds are dropped before their future is set, ready ones hold a cache.
+		if (e.light.wait_for(seconds(0)) != future_status::ready)
+			continue;
+		LightType const& light = e.light.get();
+		ethash_light_item_cache_stats(light->light, &ret.itemHits, &ret.itemMisses);
+		for (auto l: light->lights)
+			if (l != light->light)
+				ethash_light_item_cache_stats(l, &ret.itemHits, &ret.itemMisses);
+	}
+	ret.capacity = ethash.m_lightCapacity;
+	return ret;
+}
+
+void EthashAux::setNumaReplication(bool _enabled)
+{
+	get().m_numaReplication = _enabled;
+}
+
+unsigned EthashAux::numaCopies()
+{
+	return get().m_numaReplication ? (unsigned)Numa::nodes().size() : 1;
+}
+
+void EthashAux::setLazyDataset(bool _enabled)
+{
+	get().m_lazyDataset = _enabled;
+}
+
+void EthashAux::setItemCacheSize(uint64_t _bytes)
+{
+	get().m_itemCacheBytes = _bytes;
 }
 
 EthashAux::LightAllocation::LightAllocation(h256 const& _seedHash)
 {
-	uint64_t blockNumber = EthashAux::number(_seedHash);
-	light = ethash_light_new(blockNumber);
+	EpochInfo const& epoch = EpochRegistry::get().byBlock(EthashAux::number(_seedHash));
+	size = epoch.cacheSize;
+	void* cache = nullptr;
+	if (EpochShare::enabled())
+	{
+		shared = EpochShare::acquire(EpochShare::Kind::Light, epoch, size, [&](void* _cache)
+		{
+			EpochStore::Mapping stored = EpochStore::load(EpochStore::Kind::Light, epoch);
+			if (stored)
+				memcpy(_cache, stored.data(), size);
+			else if (ethash_compute_cache_nodes((node*)_cache, size, (ethash_h256_t const*)_seedHash.data()))
+				EpochStore::save(EpochStore::Kind::Light, epoch, _cache, size);
+			else
+				return false;
+			return true;
+		});
+		cache = const_cast<void*>(shared.data());
+	}
+	if (!cache)
+	{
+		mapping = EpochStore::load(EpochStore::Kind::Light, epoch);
+		cache = mapping.data();
+	}
+	if (!cache)
+	{
+		buffer = LargeBuffer::allocate(size);
+		if (!buffer)
+			BOOST_THROW_EXCEPTION(ExternalFunctionFailure("LargeBuffer::allocate()"));
+		cnote << "Light cache for block" << epoch.firstBlock << "uses" << describe(buffer);
+		if (!ethash_compute_cache_nodes((node*)buffer.data(), size, (ethash_h256_t const*)_seedHash.data()))
+			BOOST_THROW_EXCEPTION(ExternalFunctionFailure("ethash_compute_cache_nodes()"));
+		cache = buffer.data();
+		EpochStore::save(EpochStore::Kind::Light, epoch, cache, size);
+	}
+	light = ethash_light_wrap_internal(cache, size, epoch.firstBlock);
 	if (!light)
-		BOOST_THROW_EXCEPTION(ExternalFunctionFailure("ethash_light_new()"));
-	size = ethash_get_cachesize(blockNumber);
+		BOOST_THROW_EXCEPTION(ExternalFunctionFailure("ethash_light_wrap_internal()"));
+
+	if (numaCopies() > 1)
+	{
+		copies = replicate(cache, size, cache == buffer.data(), "light cache", epoch.firstBlock);
+		for (auto const& c: copies)
+		{
+			ethash_light_t l = c ? ethash_light_wrap_internal(c.data(), size, epoch.firstBlock) : light;
+			if (!l)
+			{
+				for (auto k: lights)
+					if (k != light)
+						ethash_light_delete(k);
+				ethash_light_delete(light);
+				BOOST_THROW_EXCEPTION(ExternalFunctionFailure("ethash_light_wrap_internal()"));
+			}
+			lights.push_back(l);
+		}
+	}
+
+	if (uint64_t itemCacheBytes = get().m_itemCacheBytes)
+	{
+		bool enabled = ethash_light_set_item_cache(light, itemCacheBytes);
+		for (auto l: lights)
+			if (l != light)
+				enabled = ethash_light_set_item_cache(l, itemCacheBytes) && enabled;
+		if (!enabled)
+			cwarn << "Out of memory for the DAG item cache of block" << epoch.firstBlock;
+	}
+
+	if (get().m_lazyDataset)
+	{
+		lazyData = LargeBuffer::reserve(epoch.dagSize);
+		if (lazyData)
+			lazy = ethash_lazy_new_internal((node*)lazyData.data(), epoch.dagSize, light);
+		if (!lazy)
+			cwarn << "Can't reserve a lazy dataset for block" << epoch.firstBlock << ", verifying from the light cache.";
+	}
 }
 
 EthashAux::LightAllocation::~LightAllocation()
 {
+	if (lazy)
+		ethash_lazy_delete(lazy);
+	for (auto l: lights)
+		if (l != light)
+			ethash_light_delete(l);
 	ethash_light_delete(light);
 }
 
+ethash_light_t EthashAux::LightAllocation::local() const
+{
+	return lights.empty() ? light : lights[Numa::currentNode()];
+}
+
 bytesConstRef EthashAux::LightAllocation::data() const
 {
 	return bytesConstRef((byte const*)light->cache, size);
@@ -107,7 +340,175 @@ bytesConstRef EthashAux::LightAllocation::data() const
 
 Result EthashAux::LightAllocation::compute(h256 const& _headerHash, uint64_t _nonce) const
 {
-	ethash_return_value r = ethash_light_compute(light, *(ethash_h256_t*)_headerHash.data(), _nonce);
+	ethash_h256_t const header = *(ethash_h256_t*)_headerHash.data();
+	ethash_return_value r = lazy ? ethash_lazy_compute(lazy, header, _nonce) : ethash_light_compute(local(), header, _nonce);
+	if (!r.success)
+		BOOST_THROW_EXCEPTION(DAGCreationFailure());
+	return Result{h256((uint8_t*)&r.result, h256::ConstructFromPointer), h256((uint8_t*)&r.mix_hash, h256::ConstructFromPointer)};
+}
+
+std::vector<Result> EthashAux::LightAllocation::compute(h256 const& _headerHash, std::vector<uint64_t> const& _nonces) const
+{
+	if (lazy)
+	{
+		// Nonces are a few memory reads each once their pages are in.
+		std::vector<Result> ret;
+		ret.reserve(_nonces.size());
+		for (uint64_t n: _nonces)
+			ret.push_back(compute(_headerHash, n));
+		return ret;
+	}
+	std::vector<ethash_h256_t> headers(_nonces.size(), *(ethash_h256_t*)_headerHash.data());
+	std::vector<ethash_return_value_t> r(_nonces.size());
+	ethash_light_compute_batch(local(), headers.data(), _nonces.data(), (unsigned)_nonces.size(), r.data());
+	std::vector<Result> ret;
+	ret.reserve(r.size());
+	for (auto const& i: r)
+	{
+		if (!i.success)
+			BOOST_THROW_EXCEPTION(DAGCreationFailure());
+		ret.push_back(Result{h256((uint8_t*)&i.result, h256::ConstructFromPointer), h256((uint8_t*)&i.mix_hash, h256::ConstructFromPointer)});
+	}
+	return ret;
+}
+
+EthashAux::FullType EthashAux::full(h256 const& _seedHash, bool _createIfMissing, DAGBuilder::Progress const& _progress)
+{
+	EthashAux& ethash = EthashAux::get();
+	FullType ret;
+	{
+		unique_lock<Mutex> l(ethash.x_fulls);
+		bool waited = false;
+		while (true)
+		{
+			auto it = ethash.m_fulls.find(_seedHash);
+			if (it != ethash.m_fulls.end() && (ret = it->second.lock()))
+			{
+				ethash.m_lastUsedFull = ret;
+				return ret;
+			}
+			if (!_createIfMissing)
+				return FullType();
+			// The generation we waited for was cancelled, most likely for another epoch.
+			if (waited && (!ethash.m_isBuildingFull || ethash.m_fullBuilding != _seedHash))
+				return FullType();
+			if (!ethash.m_isBuildingFull)
+				break;
+			if (ethash.m_fullBuilding == _seedHash)
+				waited = true;
+			else
+				ethash.m_fullAbort = true;
+			ethash.m_fullBuilt.wait(l);
+		}
+
+		// Don't keep the previous epoch alive while allocating the next one.
+		ethash.m_lastUsedFull.reset();
+		ethash.m_isBuildingFull = true;
+		ethash.m_fullBuilding = _seedHash;
+		ethash.m_fullAbort = false;
+	}
+
+	bool cancelled = false;
+	try
+	{
+		ret = make_shared<FullAllocation>(light(_seedHash), [&](unsigned _percent)
+		{
+			cancelled = ethash.m_fullAbort || (_progress && !_progress(_percent));
+			return !cancelled;
+		});
+	}
+	catch (...)
+	{
+		DEV_GUARDED(ethash.x_fulls)
+			ethash.m_isBuildingFull = false;
+		ethash.m_fullBuilt.notify_all();
+		if (cancelled)
+			return FullType();
+		throw;
+	}
+
+	DEV_GUARDED(ethash.x_fulls)
+	{
+		ethash.m_fulls[_seedHash] = ethash.m_lastUsedFull = ret;
+		ethash.m_isBuildingFull = false;
+	}
+	ethash.m_fullBuilt.notify_all();
+
+	// Saving checksums and writes the whole dataset, so the miners waiting for it don't
+	// wait for the disk too. The thread keeps the dataset alive until it is written.
+	if (!ret->mapping && !EpochStore::directory().empty())
+		thread([ret, _seedHash]()
+		{
+			setThreadName("dagsave");
+			EpochStore::save(EpochStore::Kind::Full, *EpochRegistry::get().bySeed(_seedHash), ethash_full_dag(ret->full), ret->size);
+		}).detach();
+	return ret;
+}
+
+EthashAux::FullAllocation::FullAllocation(LightType const& _light, DAGBuilder::Progress const& _progress)
+{
+	EpochInfo const& epoch = EpochRegistry::get().byBlock(_light->light->block_number);
+	size = epoch.dagSize;
+	mapping = EpochStore::load(EpochStore::Kind::Full, epoch);
+	if (!mapping)
+	{
+		buffer = LargeBuffer::allocate(size);
+		if (!buffer)
+			BOOST_THROW_EXCEPTION(ExternalFunctionFailure("LargeBuffer::allocate()"));
+		cnote << "DAG for block" << epoch.firstBlock << "uses" << describe(buffer);
+	}
+	full = ethash_full_wrap_internal((node*)(mapping ? mapping.data() : buffer.data()), size, epoch.firstBlock);
+	if (!full)
+		BOOST_THROW_EXCEPTION(ExternalFunctionFailure("ethash_full_wrap_internal()"));
+	if (!mapping)
+	{
+		if (!DAGBuilder().build(full, _light->light, _progress))
+		{
+			ethash_full_delete(full);
+			BOOST_THROW_EXCEPTION(DAGCreationFailure());
+		}
+	}
+
+	if (numaCopies() > 1)
+	{
+		copies = replicate(mapping ? mapping.data() : buffer.data(), size, !mapping, "DAG", epoch.firstBlock);
+		for (auto const& c: copies)
+		{
+			ethash_full_t f = c ? ethash_full_wrap_internal((node*)c.data(), size, epoch.firstBlock) : full;
+			if (!f)
+			{
+				for (auto k: fulls)
+					if (k != full)
+						ethash_full_delete(k);
+				ethash_full_delete(full);
+				BOOST_THROW_EXCEPTION(ExternalFunctionFailure("ethash_full_wrap_internal()"));
+			}
+			fulls.push_back(f);
+		}
+	}
+}
+
+EthashAux::FullAllocation::~FullAllocation()
+{
+	for (auto f: fulls)
+		if (f != full)
+			ethash_full_delete(f);
+	ethash_full_delete(full);
+}
+
+ethash_full_t EthashAux::FullAllocation::local() const
+{
+	return fulls.empty() ? full : fulls[Numa::currentNode()];
+}
+
+bytesConstRef EthashAux::FullAllocation::data() const
+{
+	return bytesConstRef((byte const*)ethash_full_dag(full), size);
+}
+
+Result EthashAux::FullAllocation::compute(h256 const& _headerHash, uint64_t _nonce) const
+{
+	ethash_return_value r = ethash_full_compute(local(), *(ethash_h256_t*)_headerHash.data(), _nonce);
 	if (!r.success)
 		BOOST_THROW_EXCEPTION(DAGCreationFailure());
 	return Result{h256((uint8_t*)&r.result, h256::ConstructFromPointer), h256((uint8_t*)&r.mix_hash, h256::ConstructFromPointer)};
@@ -117,6 +518,10 @@ Result EthashAux::eval(h256 const& _seedHash, h256 const& _headerHash, uint64_t
 {
 	try
 	{
+		// Prefer a generated dataset when one is around; it needs a few memory reads
+		// per nonce instead of recomputing 128 DAG items from the light cache.
+		if (FullType dag = full(_seedHash))
+			return dag->compute(_headerHash, _nonce);
 		return get().light(_seedHash)->compute(_headerHash, _nonce);
 	}
 	catch(...)
@@ -124,3 +529,23 @@ Result EthashAux::eval(h256 const& _seedHash, h256 const& _headerHash, uint64_t
 		return Result{~h256(), h256()};
 	}
 }
+
+std::vector<Result> EthashAux::evalBatch(h256 const& _seedHash, h256 const& _headerHash, std::vector<uint64_t> const& _nonces) noexcept
+{
+	try
+	{
+		if (FullType dag = full(_seedHash))
+		{
+			std::vector<Result> ret;
+			ret.reserve(_nonces.size());
+			for (uint64_t n: _nonces)
+				ret.push_back(dag->compute(_headerHash, n));
+			return ret;
+		}
+		return get().light(_seedHash)->compute(_headerHash, _nonces);
+	}
+	catch(...)
+	{
+		return std::vector<Result>(_nonces.size(), Result{~h256(), h256()});
+	}
+}
@@ -22,10 +22,16 @@
 #pragma once
 
 #include <condition_variable>
+#include <future>
+#include <list>
 #include <libethash/ethash.h>
 #include <libdevcore/Log.h>
+#include <libdevcore/Memory.h>
 #include <libdevcore/Worker.h>
 #include "BlockHeader.h"
+#include "DAGBuilder.h"
+#include "EpochShare.h"
+#include "EpochStore.h"
 
 namespace dev
 {
@@ -47,29 +53,134 @@ public:
 		~LightAllocation();
 		bytesConstRef data() const;
 		Result compute(h256 const& _headerHash, uint64_t _nonce) const;
+		std::vector<Result> compute(h256 const& _headerHash, std::vector<uint64_t> const& _nonces) const;
+		/// @returns the copy of the cache on the NUMA node of the calling thread.
+		ethash_light_t local() const;
 		ethash_light_t light;
 		uint64_t size;
+		EpochStore::Mapping mapping;	///< Holds the cache if it was loaded from disk.
+		EpochShare::Segment shared;		///< Holds the cache if it is shared with other processes.
+		LargeBuffer buffer;				///< Holds the cache otherwise.
+		std::vector<LargeBuffer> copies;		///< By NUMA node, if replicated; empty where light is local.
+		std::vector<ethash_light_t> lights;		///< By NUMA node, if replicated.
+		LargeBuffer lazyData;					///< Address space of the lazy dataset.
+		ethash_lazy_t lazy = nullptr;			///< Dataset filled in as compute() reads it, if enabled.
 	};
 
 	using LightType = std::shared_ptr<LightAllocation>;
 
+	struct LightCacheStats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint64_t buildMs = 0;	///< Total time spent generating light caches.
+		uint64_t itemHits = 0;	///< DAG item cache lookups of the caches held, see setItemCacheSize().
+		uint64_t itemMisses = 0;
+		unsigned size = 0;
+		unsigned capacity = 0;
+	};
+
+	/// Number of light caches kept by default: the current and the next epoch.
+	static const unsigned c_defaultLightCacheCapacity = 2;
+
+	struct FullAllocation
+	{
+		FullAllocation(LightType const& _light, DAGBuilder::Progress const& _progress = DAGBuilder::Progress());
+		~FullAllocation();
+		bytesConstRef data() const;
+		Result compute(h256 const& _headerHash, uint64_t _nonce) const;
+		/// @returns the copy of the dataset on the NUMA node of the calling thread.
+		ethash_full_t local() const;
+		ethash_full_t full;
+		uint64_t size;
+		EpochStore::Mapping mapping;	///< Holds the dataset if it was loaded from disk.
+		LargeBuffer buffer;				///< Holds the dataset otherwise.
+		std::vector<LargeBuffer> copies;		///< By NUMA node, if replicated; empty where full is local.
+		std::vector<ethash_full_t> fulls;		///< By NUMA node, if replicated.
+	};
+
+	using FullType = std::shared_ptr<FullAllocation>;
+
+	/// @returns the seed hash of the epoch containing block @a _number.
 	static h256 seedHash(unsigned _number);
+	/// @returns the first block of the epoch with the given seed hash.
 	static uint64_t number(h256 const& _seedHash);
 
 	static LightType light(h256 const& _seedHash);
 
+	/// Sets how many light caches are kept; the least recently used ones are dropped
+	/// beyond that. Holders of a dropped LightType keep it alive until they release it, and
+	/// light() returns it again meanwhile.
+	static void setLightCacheCapacity(unsigned _capacity);
+	static LightCacheStats lightCacheStats();
+
+	/// Sets whether light caches and datasets generated from now on are copied to every
+	/// NUMA node, so that threads read the copy on their own node. Costs a copy per node.
+	static void setNumaReplication(bool _enabled);
+	/// @returns the number of copies kept of each light cache and dataset.
+	static unsigned numaCopies();
+
+	/// Sets whether light caches created from now on verify against a dataset computed a
+	/// page at a time as hashes read it. Verification then gets close to full dataset speed
+	/// once the pages in use are filled, using memory only for those.
+	static void setLazyDataset(bool _enabled);
+
+	/// Sets how many bytes of the DAG items computed from each light cache created from now
+	/// on are kept for reuse by later verifications; 0 keeps none.
+	static void setItemCacheSize(uint64_t _bytes);
+
+	/// @returns the full dataset for the given seed hash. Unless @a _createIfMissing is set,
+	/// only a dataset which is still held elsewhere is returned and no DAG is generated.
+	/// Only one dataset is generated at a time; callers asking for the same seed wait for
+	/// it and a request for another seed cancels it. A null pointer is returned if the
+	/// generation was cancelled, either that way or by @a _progress.
+	static FullType full(h256 const& _seedHash, bool _createIfMissing = false, DAGBuilder::Progress const& _progress = DAGBuilder::Progress());
+
 	static Result eval(h256 const& _seedHash, h256 const& _headerHash, uint64_t  _nonce) noexcept;
 
+	/// Same as eval() for several nonces of one header. Verifies the nonces together,
+	/// which is several times faster than one by one when no full dataset is held.
+	static std::vector<Result> evalBatch(h256 const& _seedHash, h256 const& _headerHash, std::vector<uint64_t> const& _nonces) noexcept;
+
 private:
 	EthashAux() = default;
 	static EthashAux& get();
 
-	Mutex x_lights;
-	std::unordered_map<h256, LightType> m_lights;
+	/// Drops the least recently used light caches beyond the capacity. Needs x_lights.
+	void evictLights();
+	/// Puts @a _light back into the cache as the most recently used. Needs x_lights.
+	void insertLight(h256 const& _seedHash, std::shared_future<LightType> const& _light, uint64_t _id);
 
-	Mutex x_epochs;
-	std::unordered_map<h256, unsigned> m_epochs;
-	h256s m_seedHashes;
+	struct LightEntry
+	{
+		h256 seed;
+		std::shared_future<LightType> light;	///< Ready once the cache is generated.
+		uint64_t id;							///< Tells apart entries of the same seed.
+	};
+	using LightList = std::list<LightEntry>;
+
+	/// Only guards the bookkeeping below; caches are generated outside of it.
+	Mutex x_lights;
+	LightList m_lightsLRU;		///< Most recently used first.
+	std::unordered_map<h256, LightList::iterator> m_lights;
+	/// Evicted caches, found again while something else still holds them, e.g. the next
+	/// epoch's one held by the EpochPrefetcher.
+	std::unordered_map<h256, std::weak_ptr<LightAllocation>> m_evictedLights;
+	unsigned m_lightCapacity = c_defaultLightCacheCapacity;
+	LightCacheStats m_lightStats;
+	uint64_t m_lightIds = 0;
+	std::atomic<bool> m_numaReplication = {false};
+	std::atomic<bool> m_lazyDataset = {false};
+	std::atomic<uint64_t> m_itemCacheBytes = {0};
+
+	Mutex x_fulls;
+	std::unordered_map<h256, std::weak_ptr<FullAllocation>> m_fulls;
+	FullType m_lastUsedFull;
+	bool m_isBuildingFull = false;
+	h256 m_fullBuilding;						///< Seed of the dataset being generated, if m_isBuildingFull.
+	std::atomic<bool> m_fullAbort = {false};	///< Set to cancel the generation of m_fullBuilding.
+	std::condition_variable m_fullBuilt;
 };
 
 struct WorkPackage
@@ -93,6 +204,10 @@ struct WorkPackage
 	int job_len = 8;
 };
 
+/// A work package as published to the miners. Never modified once published, so the
+/// miners share one instance.
+using WorkPackagePtr = std::shared_ptr<WorkPackage const>;
+
 struct Solution
 {
 	uint64_t nonce;
@@ -26,15 +26,13 @@
 #include <thread>
 #include <list>
 #include <atomic>
+#include <cmath>
 #include <libdevcore/Common.h>
 #include <libdevcore/Worker.h>
 #include <libethcore/Miner.h>
 #include <libethcore/BlockHeader.h>
-#include <libhwmon/wrapnvml.h>
-#include <libhwmon/wrapadl.h>
-#if defined(__linux)
-#include <libhwmon/wrapamdsysfs.h>
-#endif
+#include <libethcore/EpochPrefetcher.h>
+#include <libethcore/HwMonitorSampler.h>
 
 namespace dev
 {
@@ -64,27 +62,10 @@ public:
 		// per run randomized start place, without creating much overhead.
 		random_device engine;
 		m_nonce_scrambler = uniform_int_distribution<uint64_t>()(engine);
-
-		// Init HWMON
-		adlh = wrap_adl_create();
-#if defined(__linux)
-		sysfsh = wrap_amdsysfs_create();
-#endif
-		nvmlh = wrap_nvml_create();
 	}
 
 	~Farm()
 	{
-		// Deinit HWMON
-		if (adlh)
-			wrap_adl_destroy(adlh);
-#if defined(__linux)
-		if (sysfsh)
-			wrap_amdsysfs_destroy(sysfsh);
-#endif
-		if (nvmlh)
-			wrap_nvml_destroy(nvmlh);
-
 		// Stop mining
 		stop();
 	}
@@ -95,20 +76,25 @@ public:
 	 */
 	void setWork(WorkPackage const& _wp)
 	{
-		//Collect hashrate before miner reset their work
-		collectHashRate();
-
 		// Set work to each miner
 		Guard l(x_minerWork);
 		if (_wp.header == m_work.header && _wp.startNonce == m_work.startNonce)
 			return;
 		m_work = _wp;
+		WorkPackagePtr const work = std::make_shared<WorkPackage const>(m_work);
 		for (auto const& m: m_miners)
-			m->setWork(m_work);
+			m->setWork(work);
+		m_epochPrefetcher.notify(m_work.seed);
 	}
 
 	void setSealers(std::map<std::string, SealerDescriptor> const& _sealers) { m_sealers = _sealers; }
 
+	/**
+	 * @brief Whether the miners' temperatures and fans, and with @a _power their power
+	 * draw, are sampled in the background for miningProgress(). Set before start().
+	 */
+	void setHwMonitors(bool _enabled, bool _power) { m_hwmonEnabled = _enabled; m_hwmon.setPower(_power); }
+
 	/**
 	 * @brief Start a number of miners.
 	 */
@@ -137,6 +123,12 @@ public:
 			ins += start;
 			m_miners.reserve(ins);
 		}
+		// The hash counters are sized for a fixed number of miners.
+		if (ins > HashrateEngine::c_maxMiners)
+		{
+			cwarn << "Too many devices: only" << HashrateEngine::c_maxMiners << "miners are supported, not starting" << ins - HashrateEngine::c_maxMiners << "of the" << _sealer << "miners";
+			ins = HashrateEngine::c_maxMiners;
+		}
 		for (unsigned i = start; i < ins; ++i)
 		{
 			// TODO: Improve miners creation, use unique_ptr.
@@ -146,10 +138,22 @@ public:
 			// package.
 			m_miners.back()->startWorking();
 		}
+		m_hashrate.setMiners(m_miners.size());
+		if (!mixed)
+			m_hashrate.reset();
+		if (m_hwmonEnabled)
+		{
+			m_hwmon.setMiners(m_miners);
+			m_hwmon.startWorking();
+		}
 		m_isMining = true;
 		m_lastSealer = _sealer;
 		b_lastMixed = mixed;
 
+		// Only the CPU miner uses a DAG in host memory.
+		m_epochPrefetcher.setPrefetchFull(_sealer == "cpu");
+		m_epochPrefetcher.startWorking();
+
 		// Start hashrate collector
 		m_hashrateTimer.cancel();
 		m_hashrateTimer.expires_from_now(boost::posix_time::milliseconds(1000));
@@ -170,53 +174,27 @@ public:
 	 */
 	void stop()
 	{
+		// The sampler holds the miners too.
+		m_hwmon.stopWorking();
+		m_hwmon.setMiners({});
 		{
 			Guard l(x_minerWork);
 			m_miners.clear();
 			m_isMining = false;
 		}
+		m_epochPrefetcher.stopWorking();
 
 		m_hashrateTimer.cancel();
 		m_io_service.stop();
 
-		m_lastProgresses.clear();
+		m_hashrate.setMiners(0);
+		m_hashrate.reset();
 	}
 
-    void collectHashRate()
-    {
-        auto now = std::chrono::steady_clock::now();
-
-        std::lock_guard<std::mutex> lock(x_minerWork);
-
-        WorkingProgress p;
-        p.ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_lastStart).count();
-        m_lastStart = now;
-
-        // Collect & Reset
-        for (auto const& i : m_miners)
-        {
-            uint64_t minerHashCount = i->hashCount();
-			i->resetHashCount();
-            p.hashes += minerHashCount;
-            p.minersHashes.push_back(minerHashCount);
-        }
-
-        if (p.hashes > 0)
-            m_lastProgresses.push_back(p);
-
-        // We smooth the hashrate over the last x seconds
-        uint64_t allMs = 0;
-        for (auto const& cp : m_lastProgresses)
-            allMs += cp.ms;
-
-        if (allMs > m_hashrateSmoothInterval)
-            m_lastProgresses.erase(m_lastProgresses.begin());
-    }
-
 	void processHashRate(const boost::system::error_code& ec) {
 
 		if (!ec) {
-			collectHashRate();
+			m_hashrate.sample();
 
 			// Restart timer 	
 			m_hashrateTimer.cancel();
@@ -242,93 +220,31 @@ public:
 
     /**
      * @brief Get information on the progress of mining this work package.
-     * @return The progress with mining so far.
+     * @return The hashrates at the latest sample, over 10 s in hashes and ms.
      */
-    WorkingProgress const& miningProgress(bool hwmon = false, bool power = false) const
+    WorkingProgress miningProgress(bool hwmon = false, bool power = false) const
     {
-        std::lock_guard<std::mutex> lock(x_minerWork);
+        HashrateEngine::Snapshot s = m_hashrate.snapshot();
+        unsigned window = HashrateEngine::c_windowSeconds[HashrateEngine::Short];
         WorkingProgress p;
-        p.ms = 0;
-        p.hashes = 0;
-        for (auto const& i : m_miners)
+        p.ms = window * 1000;
+        p.hashes = std::llround(s.rate[HashrateEngine::Short] * window);
+        for (unsigned i = 0; i < s.miners; ++i)
+            p.minersHashes.push_back(std::llround(s.minerRate[i][HashrateEngine::Short] * window));
+        p.minuteRate = std::llround(s.rate[HashrateEngine::Medium]);
+        p.quarterRate = std::llround(s.rate[HashrateEngine::Long]);
+        if (!hwmon)
+            return p;
+
+        // The sampler's latest readings; only its thread queries the drivers.
+        HwMonitorSnapshot hw = m_hwmon.snapshot();
+        for (HwMonitor m : *hw)
         {
-            p.minersHashes.push_back(0);
-			if (hwmon) {
-				HwMonitorInfo hwInfo = i->hwmonInfo();
-				HwMonitor hw;
-				unsigned int tempC = 0, fanpcnt = 0, powerW = 0;
-				if (hwInfo.deviceIndex >= 0) {
-					if (hwInfo.deviceType == HwMonitorInfoType::NVIDIA && nvmlh) {
-						int typeidx = 0;
-						if(hwInfo.indexSource == HwMonitorIndexSource::CUDA){
-							typeidx = nvmlh->cuda_nvml_device_id[hwInfo.deviceIndex];
-						}
-						else if(hwInfo.indexSource == HwMonitorIndexSource::OPENCL){
-							typeidx = nvmlh->opencl_nvml_device_id[hwInfo.deviceIndex];
-						}
-						else{
-							//Unknown, don't map
-							typeidx = hwInfo.deviceIndex;
-						}
-						wrap_nvml_get_tempC(nvmlh, typeidx, &tempC);
-						wrap_nvml_get_fanpcnt(nvmlh, typeidx, &fanpcnt);
-						if(power) {
-							wrap_nvml_get_power_usage(nvmlh, typeidx, &powerW);
-						}
-					}
-					else if (hwInfo.deviceType == HwMonitorInfoType::AMD && adlh) {
-						int typeidx = 0;
-						if(hwInfo.indexSource == HwMonitorIndexSource::OPENCL){
-							typeidx = adlh->opencl_adl_device_id[hwInfo.deviceIndex];
-						}
-						else{
-							//Unknown, don't map
-							typeidx = hwInfo.deviceIndex;
-						}
-						wrap_adl_get_tempC(adlh, typeidx, &tempC);
-						wrap_adl_get_fanpcnt(adlh, typeidx, &fanpcnt);
-						if(power) {
-							wrap_adl_get_power_usage(adlh, typeidx, &powerW);
-						}
-					}
-#if defined(__linux)
-					// Overwrite with sysfs data if present
-					if (hwInfo.deviceType == HwMonitorInfoType::AMD && sysfsh) {
-						int typeidx = 0;
-						if(hwInfo.indexSource == HwMonitorIndexSource::OPENCL){
-							typeidx = sysfsh->opencl_sysfs_device_id[hwInfo.deviceIndex];
-						}
-						else{
-							//Unknown, don't map
-							typeidx = hwInfo.deviceIndex;
-						}
-						wrap_amdsysfs_get_tempC(sysfsh, typeidx, &tempC);
-						wrap_amdsysfs_get_fanpcnt(sysfsh, typeidx, &fanpcnt);
-						if(power) {
-							wrap_amdsysfs_get_power_usage(sysfsh, typeidx, &powerW);
-						}
-					}
-#endif
-				}
-				hw.tempC = tempC;
-				hw.fanP = fanpcnt;
-				hw.powerW = powerW/((double)1000.0);
-				p.minerMonitors.push_back(hw);
-			}
+            if (!power)
+                m.powerW = 0;
+            p.minerMonitors.push_back(m);
         }
-
-        for (auto const& cp : m_lastProgresses)
-        {
-            p.ms += cp.ms;
-            p.hashes += cp.hashes;
-            for (unsigned int i = 0; i < cp.minersHashes.size() && i < p.minersHashes.size(); i++)
-            {
-                p.minersHashes.at(i) += cp.minersHashes.at(i);
-            }
-        }
-
-        m_progress = p;
-        return m_progress;
+        return p;
     }
 
 	SolutionStats getSolutionStats() {
@@ -339,6 +255,19 @@ public:
 		m_solutionStats.failed();
 	}
 
+	std::atomic<uint64_t>& hashCounter(unsigned _index) override {
+		assert(_index < HashrateEngine::c_maxMiners);
+		return m_hashrate.counter(_index);
+	}
+
+	void verifySolution(SolutionCandidate&& _c) override {
+		m_verifier.enqueue(std::move(_c));
+	}
+
+	VerifierStats getVerifierStats() const {
+		return m_verifier.stats();
+	}
+
 	void acceptedSolution(bool _stale) {
 		if (!_stale)
 		{
@@ -420,13 +349,17 @@ private:
 		m_onSolutionFound(_s);
 	}
 
+	HashrateEngine m_hashrate;		///< Declared first: the miners hold its counters.
+
 	mutable Mutex x_minerWork;
 	std::vector<std::shared_ptr<Miner>> m_miners;
 	WorkPackage m_work;
 
-	std::atomic<bool> m_isMining = {false};
+	EpochPrefetcher m_epochPrefetcher;
+	HwMonitorSampler m_hwmon;
+	bool m_hwmonEnabled = false;
 
-	mutable WorkingProgress m_progress;
+	std::atomic<bool> m_isMining = {false};
 
 	SolutionFound m_onSolutionFound;
 	MinerRestart m_onMinerRestart;
@@ -435,12 +368,9 @@ private:
 	std::string m_lastSealer;
 	bool b_lastMixed = false;
 
-	std::chrono::steady_clock::time_point m_lastStart;
-	uint64_t m_hashrateSmoothInterval = 10000;
 	std::thread m_serviceThread;  ///< The IO service thread.
 	boost::asio::io_service m_io_service;
 	boost::asio::deadline_timer m_hashrateTimer;
-	std::vector<WorkingProgress> m_lastProgresses;
 
 	mutable SolutionStats m_solutionStats;
 	std::chrono::steady_clock::time_point m_farm_launched = std::chrono::steady_clock::now();
@@ -448,11 +378,8 @@ private:
     	string m_pool_addresses;
 	uint64_t m_nonce_scrambler;
 
-	wrap_nvml_handle *nvmlh = NULL;
-	wrap_adl_handle *adlh = NULL;
-#if defined(__linux)
-	wrap_amdsysfs_handle *sysfsh = NULL;
-#endif
+	// Last, so its threads stop before anything they submit to goes away.
+	SolutionVerifier m_verifier{*this};
 }; 
 
 }
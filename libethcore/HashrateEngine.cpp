@@ -0,0 +1,131 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file HashrateEngine.cpp
+ * Hash counters of the miners and the hashrates derived from them.
+ */
+
+#include "HashrateEngine.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace chrono;
+using namespace dev;
+using namespace eth;
+
+const unsigned HashrateEngine::c_maxMiners;
+const unsigned HashrateEngine::c_windowSeconds[HashrateEngine::Windows] = {10, 60, 900};
+const unsigned HashrateEngine::c_slots;
+
+HashrateEngine::HashrateEngine():
+	m_lastSample(steady_clock::now())
+{
+	for (Slot& s: m_slots)
+		for (unsigned w = 0; w < Windows; ++w)
+		{
+			s.rate[w].store(0, memory_order_relaxed);
+			for (unsigned i = 0; i < c_maxMiners; ++i)
+				s.minerRate[i][w].store(0, memory_order_relaxed);
+		}
+}
+
+void HashrateEngine::sample()
+{
+	Guard l(x_sample);
+	auto now = steady_clock::now();
+	double dt = duration<double>(now - m_lastSample).count();
+	if (dt <= 0)
+		return;
+	uint64_t ms = duration_cast<milliseconds>(now - m_lastSample).count();
+	m_lastSample = now;
+
+	uint64_t hashes[c_maxMiners];
+	bool idle = true;
+	for (unsigned i = 0; i < c_maxMiners; ++i)
+	{
+		hashes[i] = m_counters[i].hashes.load(memory_order_relaxed) - m_lastHashes[i];
+		m_lastHashes[i] += hashes[i];
+		idle = idle && !hashes[i];
+	}
+	// Time without any hashes, loading a DAG or without work, doesn't count, so the
+	// long windows aren't dragged down for minutes after it.
+	if (idle)
+		return;
+
+	// A sample of length dt weighs 1 - e^(-dt / window) in the average, so the
+	// averages don't depend on how regularly sample() is called.
+	double decay[Windows];
+	for (unsigned w = 0; w < Windows; ++w)
+	{
+		decay[w] = exp(-dt / c_windowSeconds[w]);
+		m_weight[w] = m_weight[w] * decay[w] + (1 - decay[w]);
+	}
+	for (unsigned i = 0; i < c_maxMiners; ++i)
+		for (unsigned w = 0; w < Windows; ++w)
+			m_average[i][w] = m_average[i][w] * decay[w] + hashes[i] / dt * (1 - decay[w]);
+	publish(min(m_miners.load(memory_order_relaxed), c_maxMiners), ms);
+}
+
+void HashrateEngine::reset()
+{
+	Guard l(x_sample);
+	m_lastSample = steady_clock::now();
+	for (unsigned i = 0; i < c_maxMiners; ++i)
+	{
+		m_lastHashes[i] = m_counters[i].hashes.load(memory_order_relaxed);
+		fill(begin(m_average[i]), end(m_average[i]), 0);
+	}
+	fill(begin(m_weight), end(m_weight), 0);
+	publish(min(m_miners.load(memory_order_relaxed), c_maxMiners), 0);
+}
+
+void HashrateEngine::publish(unsigned _miners, uint64_t _ms)
+{
+	unsigned next = (m_latest.load(memory_order_relaxed) + 1) % c_slots;
+	Slot& s = m_slots[next];
+	s.miners.store(_miners, memory_order_relaxed);
+	s.sequence.store(m_sequence++, memory_order_relaxed);
+	s.ms.store(_ms, memory_order_relaxed);
+	for (unsigned w = 0; w < Windows; ++w)
+	{
+		double total = 0;
+		for (unsigned i = 0; i < _miners; ++i)
+		{
+			double rate = m_weight[w] > 0 ? m_average[i][w] / m_weight[w] : 0;
+			s.minerRate[i][w].store(rate, memory_order_relaxed);
+			total += rate;
+		}
+		s.rate[w].store(total, memory_order_relaxed);
+	}
+	m_latest.store(next, memory_order_release);
+}
+
+HashrateEngine::Snapshot HashrateEngine::snapshot() const
+{
+	Snapshot ret;
+	Slot const& s = m_slots[m_latest.load(memory_order_acquire)];
+	ret.miners = s.miners.load(memory_order_relaxed);
+	ret.sequence = s.sequence.load(memory_order_relaxed);
+	ret.ms = s.ms.load(memory_order_relaxed);
+	for (unsigned w = 0; w < Windows; ++w)
+	{
+		ret.rate[w] = s.rate[w].load(memory_order_relaxed);
+		for (unsigned i = 0; i < ret.miners; ++i)
+			ret.minerRate[i][w] = s.minerRate[i][w].load(memory_order_relaxed);
+	}
+	return ret;
+}
@@ -0,0 +1,119 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file HashrateEngine.h
+ * Hash counters of the miners and the hashrates derived from them.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace eth
+{
+
+/**
+ * @brief Counts the miners' hashes and turns them into hashrates over several windows.
+ *
+ * Each miner adds to a counter on a cache line of its own, which only it writes, so
+ * counting costs one uncontended atomic add. sample() is called about every second
+ * from a single thread: it reads the counters without resetting them, and updates an
+ * exponentially weighted moving average of each miner's rate per window. Every sample
+ * is published to a slot of a fixed ring, from which snapshot() copies the latest
+ * without locking or retrying.
+ */
+class HashrateEngine
+{
+public:
+	static const unsigned c_maxMiners = 32;
+
+	/// Averaging windows, as time constants of the moving averages.
+	enum Window { Short, Medium, Long, Windows };
+	static const unsigned c_windowSeconds[Windows];	///< 10 s, 1 min, 15 min
+
+	/// The rates at one sample.
+	struct Snapshot
+	{
+		unsigned miners = 0;
+		uint64_t sequence = 0;					///< Samples taken before this one.
+		uint64_t ms = 0;						///< Length of the sample.
+		double rate[Windows] = {};				///< Hashes per second of all miners.
+		double minerRate[c_maxMiners][Windows] = {};
+	};
+
+	HashrateEngine();
+
+	/// The counter miner @a _miner adds its hashes to. Never reset.
+	std::atomic<uint64_t>& counter(unsigned _miner) { return m_counters[_miner].hashes; }
+
+	/// Number of miners whose rates are sampled; 0 when not mining.
+	void setMiners(unsigned _miners) { m_miners.store(_miners, std::memory_order_relaxed); }
+
+	/// Reads the counters and publishes the updated rates.
+	void sample();
+	/// Forgets the rates so far, e.g. when the miners are replaced.
+	void reset();
+
+	/// The rates at the latest sample.
+	Snapshot snapshot() const;
+
+private:
+	/// Keeps a counter away from the other miners' ones.
+	struct alignas(64) Counter
+	{
+		std::atomic<uint64_t> hashes = {0};
+		char padding[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	/// A published sample. The fields are atomic only so that a reader copying a slot
+	/// is well defined; the writer gets back to a slot c_slots - 1 samples after
+	/// publishing it, so a reader not stalled that long copies a consistent sample.
+	struct Slot
+	{
+		std::atomic<unsigned> miners = {0};
+		std::atomic<uint64_t> sequence = {0};
+		std::atomic<uint64_t> ms = {0};
+		std::atomic<double> rate[Windows];
+		std::atomic<double> minerRate[c_maxMiners][Windows];
+	};
+	static const unsigned c_slots = 16;
+
+	void publish(unsigned _miners, uint64_t _ms);
+
+	Counter m_counters[c_maxMiners];
+	std::atomic<unsigned> m_miners = {0};
+
+	// Sampler state, touched by sample() and reset() only.
+	Mutex x_sample;
+	std::chrono::steady_clock::time_point m_lastSample;
+	uint64_t m_lastHashes[c_maxMiners] = {};
+	// Moving averages of each miner's rate and of the weight of the samples so far,
+	// which corrects the averages' start from zero while they warm up.
+	double m_average[c_maxMiners][Windows] = {};
+	double m_weight[Windows] = {};
+	uint64_t m_sequence = 0;
+
+	Slot m_slots[c_slots];
+	std::atomic<unsigned> m_latest = {0};		///< Slot of the latest sample.
+};
+
+}
+}
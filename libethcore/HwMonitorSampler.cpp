@@ -0,0 +1,143 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file HwMonitorSampler.cpp
+ * Reads the miners' temperatures, fans and power in the background.
+ */
+
+#include "HwMonitorSampler.h"
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+const unsigned HwMonitorSampler::c_defaultIntervalMs;
+unsigned HwMonitorSampler::s_intervalMs = HwMonitorSampler::c_defaultIntervalMs;
+
+HwMonitorSampler::HwMonitorSampler():
+	Worker("hwmon"),
+	m_snapshot(make_shared<vector<HwMonitor> const>())
+{
+	adlh = wrap_adl_create();
+#if defined(__linux)
+	sysfsh = wrap_amdsysfs_create();
+#endif
+	nvmlh = wrap_nvml_create();
+}
+
+HwMonitorSampler::~HwMonitorSampler()
+{
+	stopWorking();
+
+	if (adlh)
+		wrap_adl_destroy(adlh);
+#if defined(__linux)
+	if (sysfsh)
+		wrap_amdsysfs_destroy(sysfsh);
+#endif
+	if (nvmlh)
+		wrap_nvml_destroy(nvmlh);
+}
+
+void HwMonitorSampler::setMiners(vector<shared_ptr<Miner>> const& _miners)
+{
+	DEV_GUARDED(x_miners)
+		m_miners = _miners;
+	// Readings of the previous miners would be attributed to the new ones.
+	atomic_store(&m_snapshot, HwMonitorSnapshot(make_shared<vector<HwMonitor> const>()));
+}
+
+void HwMonitorSampler::workLoop()
+{
+	while (!shouldStop() && s_intervalMs)
+	{
+		sample();
+		waitUntil([]() { return false; }, chrono::milliseconds(s_intervalMs));
+	}
+}
+
+void HwMonitorSampler::sample()
+{
+	vector<HwMonitorInfo> infos;
+	DEV_GUARDED(x_miners)
+		for (auto const& m: m_miners)
+			infos.push_back(m->hwmonInfo());
+
+	auto readings = make_shared<vector<HwMonitor>>();
+	for (auto const& info: infos)
+		readings->push_back(read(info));
+	atomic_store(&m_snapshot, HwMonitorSnapshot(move(readings)));
+}
+
+HwMonitor HwMonitorSampler::read(HwMonitorInfo const& _info) const
+{
+	HwMonitor hw;
+	unsigned int tempC = 0, fanpcnt = 0, powerW = 0;
+	if (_info.deviceIndex >= 0) {
+		if (_info.deviceType == HwMonitorInfoType::NVIDIA && nvmlh) {
+			int typeidx = 0;
+			if(_info.indexSource == HwMonitorIndexSource::CUDA){
+				typeidx = nvmlh->cuda_nvml_device_id[_info.deviceIndex];
+			}
+			else if(_info.indexSource == HwMonitorIndexSource::OPENCL){
+				typeidx = nvmlh->opencl_nvml_device_id[_info.deviceIndex];
+			}
+			else{
+				//Unknown, don't map
+				typeidx = _info.deviceIndex;
+			}
+			wrap_nvml_get_tempC(nvmlh, typeidx, &tempC);
+			wrap_nvml_get_fanpcnt(nvmlh, typeidx, &fanpcnt);
+			if (m_power)
+				wrap_nvml_get_power_usage(nvmlh, typeidx, &powerW);
+		}
+		else if (_info.deviceType == HwMonitorInfoType::AMD && adlh) {
+			int typeidx = 0;
+			if(_info.indexSource == HwMonitorIndexSource::OPENCL){
+				typeidx = adlh->opencl_adl_device_id[_info.deviceIndex];
+			}
+			else{
+				//Unknown, don't map
+				typeidx = _info.deviceIndex;
+			}
+			wrap_adl_get_tempC(adlh, typeidx, &tempC);
+			wrap_adl_get_fanpcnt(adlh, typeidx, &fanpcnt);
+			if (m_power)
+				wrap_adl_get_power_usage(adlh, typeidx, &powerW);
+		}
+#if defined(__linux)
+		// Overwrite with sysfs data if present
+		if (_info.deviceType == HwMonitorInfoType::AMD && sysfsh) {
+			int typeidx = 0;
+			if(_info.indexSource == HwMonitorIndexSource::OPENCL){
+				typeidx = sysfsh->opencl_sysfs_device_id[_info.deviceIndex];
+			}
+			else{
+				//Unknown, don't map
+				typeidx = _info.deviceIndex;
+			}
+			wrap_amdsysfs_get_tempC(sysfsh, typeidx, &tempC);
+			wrap_amdsysfs_get_fanpcnt(sysfsh, typeidx, &fanpcnt);
+			if (m_power)
+				wrap_amdsysfs_get_power_usage(sysfsh, typeidx, &powerW);
+		}
+#endif
+	}
+	hw.tempC = tempC;
+	hw.fanP = fanpcnt;
+	hw.powerW = powerW/((double)1000.0);
+	return hw;
+}
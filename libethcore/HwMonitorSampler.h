@@ -0,0 +1,90 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file HwMonitorSampler.h
+ * Reads the miners' temperatures, fans and power in the background.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <libdevcore/Worker.h>
+#include <libhwmon/wrapnvml.h>
+#include <libhwmon/wrapadl.h>
+#if defined(__linux)
+#include <libhwmon/wrapamdsysfs.h>
+#endif
+#include "Miner.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/// The readings of the miners' devices, in the miners' order. Never modified once published.
+using HwMonitorSnapshot = std::shared_ptr<std::vector<HwMonitor> const>;
+
+/**
+ * @brief Samples the miners' hardware monitors on a thread of its own.
+ *
+ * NVML, ADL and sysfs reads can take long, so they are done here at a fixed interval
+ * and published as an immutable snapshot; snapshot() only copies a pointer to it.
+ */
+class HwMonitorSampler: public Worker
+{
+public:
+	static const unsigned c_defaultIntervalMs = 2000;
+
+	HwMonitorSampler();
+	~HwMonitorSampler() override;
+
+	/// Time between samples in milliseconds; 0 disables sampling.
+	static void setInterval(unsigned _ms) { s_intervalMs = _ms; }
+	static unsigned interval() { return s_intervalMs; }
+
+	/// Whether the power draw is read as well; it is left 0 otherwise.
+	void setPower(bool _power) { m_power = _power; }
+
+	/// The miners to sample, replacing the previous ones.
+	void setMiners(std::vector<std::shared_ptr<Miner>> const& _miners);
+
+	/// The latest readings; empty until the first sample.
+	HwMonitorSnapshot snapshot() const { return std::atomic_load(&m_snapshot); }
+
+private:
+	void workLoop() override;
+
+	void sample();
+	HwMonitor read(HwMonitorInfo const& _info) const;
+
+	Mutex x_miners;
+	std::vector<std::shared_ptr<Miner>> m_miners;
+
+	HwMonitorSnapshot m_snapshot;		///< Accessed with the atomic shared_ptr functions.
+	std::atomic<bool> m_power = {false};
+
+	wrap_nvml_handle* nvmlh = nullptr;
+	wrap_adl_handle* adlh = nullptr;
+#if defined(__linux)
+	wrap_amdsysfs_handle* sysfsh = nullptr;
+#endif
+
+	static unsigned s_intervalMs;
+};
+
+}
+}
@@ -6,11 +6,28 @@ using namespace eth;
 
 unsigned dev::eth::Miner::s_dagLoadMode = 0;
 
-unsigned dev::eth::Miner::s_dagLoadIndex = 0;
+std::atomic<unsigned> dev::eth::Miner::s_dagLoadIndex = {0};
 
 unsigned dev::eth::Miner::s_dagCreateDevice = 0;
 
-uint8_t* dev::eth::Miner::s_dagInHostMemory = NULL;
-
 bool dev::eth::Miner::s_exit = false;
 
+DagLoadScheduler::Ticket Miner::admitDagLoad(uint64_t _hostBytes)
+{
+	m_loadStart = std::chrono::steady_clock::now();
+	DagLoadScheduler::Ticket ret = DagLoadScheduler::get().acquire(_hostBytes, [this]() { return shouldStop(); });
+	m_loadWait = std::chrono::steady_clock::now() - m_loadStart;
+	if (ret)
+		m_hashing.store(false, std::memory_order_relaxed);
+	return ret;
+}
+
+void Miner::reportHashing()
+{
+	m_hashing.store(true, std::memory_order_relaxed);
+	using std::chrono::milliseconds;
+	auto total = std::chrono::duration_cast<milliseconds>(std::chrono::steady_clock::now() - m_loadStart);
+	auto wait = std::chrono::duration_cast<milliseconds>(m_loadWait);
+	cnote << "Miner" << index << "hashing" << total.count() << "ms after requesting its DAG load, of which"
+		<< wait.count() << "ms waiting for admission.";
+}
@@ -24,11 +24,15 @@
 #include <thread>
 #include <list>
 #include <string>
+#include <memory>
 #include <boost/timer.hpp>
 #include <libdevcore/Common.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/Worker.h>
+#include "DagLoadScheduler.h"
 #include "EthashAux.h"
+#include "HashrateEngine.h"
+#include "SolutionVerifier.h"
 
 #define MINER_WAIT_STATE_WORK	 1
 
@@ -49,7 +53,8 @@ enum class MinerType
 {
 	Mixed,
 	CL,
-	CUDA
+	CUDA,
+	CPU
 };
 
 enum class HwMonitorInfoType
@@ -95,13 +100,16 @@ inline std::ostream& operator<<(std::ostream& os, HwMonitor _hw)
 /// Describes the progress of a mining operation.
 struct WorkingProgress
 {
-	uint64_t hashes = 0;		///< Total number of hashes computed.
-	uint64_t ms = 0;			///< Total number of milliseconds of mining thus far.
+	uint64_t hashes = 0;		///< Hashes computed over the last ms milliseconds.
+	uint64_t ms = 0;
 	uint64_t rate() const { return ms == 0 ? 0 : hashes * 1000 / ms; }
 
 	std::vector<uint64_t> minersHashes;
 	std::vector<HwMonitor> minerMonitors;
 	uint64_t minerRate(const uint64_t hashCount) const { return ms == 0 ? 0 : hashCount * 1000 / ms; }
+
+	uint64_t minuteRate = 0;	///< Hashes per second averaged over about a minute.
+	uint64_t quarterRate = 0;	///< Hashes per second averaged over about 15 minutes.
 };
 
 inline std::ostream& operator<<(std::ostream& _out, WorkingProgress _p)
@@ -173,6 +181,15 @@ public:
 	 */
 	virtual void submitProof(Solution const& _p) = 0;
 	virtual void failedSolution() = 0;
+
+	/**
+	 * @brief Called from a Miner to have a candidate verified, then submitted with
+	 * submitProof() or counted with failedSolution(), off the mining thread.
+	 */
+	virtual void verifySolution(SolutionCandidate&& _c) = 0;
+
+	/// The counter miner @a _index adds its hashes to.
+	virtual std::atomic<uint64_t>& hashCounter(unsigned _index) = 0;
 	virtual uint64_t get_nonce_scrambler() = 0;
 };
 
@@ -190,25 +207,27 @@ public:
 	Miner(std::string const& _name, FarmFace& _farm, size_t _index):
 		Worker(_name + std::to_string(_index)),
 		index(_index),
-		farm(_farm)
+		farm(_farm),
+		m_hashCount(_farm.hashCounter(_index)),
+		m_work(std::make_shared<WorkPackage const>()),
+		m_currentWork(m_work)
 	{}
 
 	virtual ~Miner() = default;
 
-	void setWork(WorkPackage const& _work)
+	/// Publishes @a _work to the miner thread, which picks it up on its next call to work().
+	void setWork(WorkPackagePtr const& _work)
 	{
-		{
-			Guard l(x_work);
-			m_work = _work;
-			workSwitchStart = std::chrono::high_resolution_clock::now();
-		}
+		workSwitchStart = std::chrono::high_resolution_clock::now();
+		std::atomic_store(&m_work, _work);
+		m_workSequence.fetch_add(1, std::memory_order_release);
+		wake();
 		kick_miner();
 	}
 
+	/// Hashes computed since the farm started.
 	uint64_t hashCount() const { return m_hashCount.load(std::memory_order_relaxed); }
 
-	void resetHashCount() { m_hashCount.store(0, std::memory_order_relaxed); }
-
 	unsigned Index() { return index; };
 	HwMonitorInfo hwmonInfo() { return m_hwmoninfo; }
 
@@ -221,18 +240,61 @@ public:
 protected:
 
 	/**
-	 * @brief No work left to be done. Pause until told to kickOff().
+	 * @brief New work was published: give up the search in progress to pick it up.
+	 * A miner waiting in waitForWork() is woken by setWork() itself.
 	 */
 	virtual void kick_miner() = 0;
 
-	WorkPackage work() const { Guard l(x_work); return m_work; }
+	/**
+	 * @brief The newest work package published, for the miner thread only.
+	 * Unless a package was published since the last call, this is one relaxed load.
+	 */
+	WorkPackage const& work()
+	{
+		if (m_workSequence.load(std::memory_order_relaxed) != m_seenSequence)
+		{
+			// Acquiring the sequence makes the package published with it, or a newer one,
+			// visible; a newer one is just picked up again on the next call.
+			m_seenSequence = m_workSequence.load(std::memory_order_acquire);
+			m_currentWork = std::atomic_load(&m_work);
+		}
+		return *m_currentWork;
+	}
+
+	/// The package work() last returned, shared rather than copied.
+	WorkPackagePtr const& workPtr() const { return m_currentWork; }
+
+	/// Queues @a _nonce, found for @a _work, for verification and returns immediately.
+	void verifySolution(uint64_t _nonce, WorkPackagePtr const& _work, bool _stale)
+	{
+		farm.verifySolution(SolutionCandidate{_nonce, _work, _stale, (unsigned)index, std::chrono::steady_clock::now()});
+	}
+
+	/// Blocks until a package newer than the one work() returned is published, or the
+	/// miner should stop.
+	void waitForWork()
+	{
+		waitUntil([this]() { return m_workSequence.load(std::memory_order_relaxed) != m_seenSequence; });
+	}
+
+	void addHashCount(uint64_t _n)
+	{
+		if (!m_hashing.load(std::memory_order_relaxed))
+			reportHashing();
+		m_hashCount.fetch_add(_n, std::memory_order_relaxed);
+	}
 
-	void addHashCount(uint64_t _n) { m_hashCount.fetch_add(_n, std::memory_order_relaxed); }
+	/**
+	 * @brief Waits for the DAG load scheduler to admit loading the DAG for a new epoch.
+	 * The time from the call to the first hashes counted after it is reported.
+	 * @param _hostBytes Host memory the load holds until the ticket is released.
+	 * @returns an empty ticket if the miner was stopped while waiting.
+	 */
+	DagLoadScheduler::Ticket admitDagLoad(uint64_t _hostBytes);
 
 	static unsigned s_dagLoadMode;
-	static unsigned s_dagLoadIndex;
+	static std::atomic<unsigned> s_dagLoadIndex;	///< Devices done loading the DAG.
 	static unsigned s_dagCreateDevice;
-	static uint8_t* s_dagInHostMemory;
 	static bool s_exit;
 
 	const size_t index = 0;
@@ -240,10 +302,17 @@ protected:
 	std::chrono::high_resolution_clock::time_point workSwitchStart;
 	HwMonitorInfo m_hwmoninfo;
 private:
-	std::atomic<uint64_t> m_hashCount = {0};
+	void reportHashing();
+
+	std::atomic<uint64_t>& m_hashCount;		///< The farm's counter for this miner.
+	std::atomic<bool> m_hashing = {true};	///< False from admitDagLoad() to the first hashes after it.
+	std::chrono::steady_clock::time_point m_loadStart;
+	std::chrono::steady_clock::duration m_loadWait;
 
-	WorkPackage m_work;
-	mutable Mutex x_work;
+	WorkPackagePtr m_work;						///< Accessed with the atomic shared_ptr functions.
+	std::atomic<uint64_t> m_workSequence = {0};	///< Packages published so far.
+	WorkPackagePtr m_currentWork;				///< The miner thread's reference to m_work.
+	uint64_t m_seenSequence = 0;				///< m_workSequence when m_currentWork was loaded.
 };
 
 }
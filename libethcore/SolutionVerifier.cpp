@@ -0,0 +1,145 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file SolutionVerifier.cpp
+ * Verifies the nonces found by the miners off the mining threads.
+ */
+
+#include "SolutionVerifier.h"
+#include <algorithm>
+#include "Miner.h"
+
+using namespace std;
+using namespace chrono;
+using namespace dev;
+using namespace eth;
+
+namespace
+{
+
+// Candidates of one work package verified together; see EthashAux::evalBatch().
+const size_t c_maxBatch = 16;
+
+uint64_t micros(steady_clock::duration _d)
+{
+	return duration_cast<microseconds>(_d).count();
+}
+
+void addLatency(uint64_t& _total, uint64_t& _max, uint64_t _us)
+{
+	_total += _us;
+	_max = max(_max, _us);
+}
+
+}
+
+const unsigned SolutionVerifier::c_defaultThreads;
+const unsigned SolutionVerifier::c_queueCapacity;
+unsigned SolutionVerifier::s_threads = SolutionVerifier::c_defaultThreads;
+
+SolutionVerifier::~SolutionVerifier()
+{
+	DEV_GUARDED(x_queue)
+		m_stopping = true;
+	m_queued.notify_all();
+	for (auto& t: m_threads)
+		t.join();
+}
+
+bool SolutionVerifier::enqueue(SolutionCandidate&& _c)
+{
+	{
+		Guard l(x_queue);
+		if (m_queue.size() >= c_queueCapacity)
+		{
+			++m_stats.dropped;
+			cwarn << "Verification queue full: dropping solution of miner" << _c.miner;
+			return false;
+		}
+		m_queue.push_back(move(_c));
+		if (m_threads.empty())
+			for (unsigned i = 0; i < s_threads; ++i)
+				m_threads.emplace_back([this]() { verifyLoop(); });
+	}
+	m_queued.notify_one();
+	return true;
+}
+
+void SolutionVerifier::verifyLoop()
+{
+	setThreadName("verify");
+	vector<SolutionCandidate> batch;
+	while (true)
+	{
+		{
+			unique_lock<Mutex> l(x_queue);
+			m_queued.wait(l, [&]() { return m_stopping || !m_queue.empty(); });
+			if (m_stopping)
+				return;
+			// A burst from one device is all for the same package.
+			do
+			{
+				batch.push_back(move(m_queue.front()));
+				m_queue.pop_front();
+			}
+			while (!m_queue.empty() && batch.size() < c_maxBatch && m_queue.front().work == batch.front().work);
+		}
+		verify(batch);
+		batch.clear();
+	}
+}
+
+void SolutionVerifier::verify(vector<SolutionCandidate>& _batch)
+{
+	WorkPackage const& w = *_batch.front().work;
+	vector<uint64_t> nonces;
+	for (auto const& c: _batch)
+		nonces.push_back(c.nonce);
+
+	auto start = steady_clock::now();
+	vector<Result> r = EthashAux::evalBatch(w.seed, w.header, nonces);
+	auto verified = steady_clock::now();
+
+	VerifierStats stats;
+	for (size_t i = 0; i < _batch.size(); ++i)
+	{
+		addLatency(stats.queuedUs, stats.maxQueuedUs, micros(start - _batch[i].found));
+		addLatency(stats.verifyUs, stats.maxVerifyUs, micros(verified - start));
+		if (r[i].value < w.boundary)
+		{
+			auto submit = steady_clock::now();
+			m_farm.submitProof(Solution{_batch[i].nonce, r[i].mixHash, w, _batch[i].stale});
+			addLatency(stats.submitUs, stats.maxSubmitUs, micros(steady_clock::now() - submit));
+			++stats.verified;
+		}
+		else
+		{
+			m_farm.failedSolution();
+			cwarn << "FAILURE: GPU" << _batch[i].miner << "gave incorrect result!";
+			++stats.failed;
+		}
+	}
+
+	Guard l(x_queue);
+	m_stats.verified += stats.verified;
+	m_stats.failed += stats.failed;
+	m_stats.queuedUs += stats.queuedUs;
+	m_stats.maxQueuedUs = max(m_stats.maxQueuedUs, stats.maxQueuedUs);
+	m_stats.verifyUs += stats.verifyUs;
+	m_stats.maxVerifyUs = max(m_stats.maxVerifyUs, stats.maxVerifyUs);
+	m_stats.submitUs += stats.submitUs;
+	m_stats.maxSubmitUs = max(m_stats.maxSubmitUs, stats.maxSubmitUs);
+}
@@ -0,0 +1,119 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file SolutionVerifier.h
+ * Verifies the nonces found by the miners off the mining threads.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <libdevcore/Guards.h>
+#include "EthashAux.h"
+
+namespace dev
+{
+namespace eth
+{
+
+class FarmFace;
+
+/// A nonce a device reported as meeting the boundary of its work package.
+struct SolutionCandidate
+{
+	uint64_t nonce;
+	WorkPackagePtr work;
+	bool stale;			///< Newer work had been published when it was found.
+	unsigned miner;		///< Index of the miner that found it.
+	std::chrono::steady_clock::time_point found;
+};
+
+/// Verification counters, with the time candidates spend in each stage.
+struct VerifierStats
+{
+	uint64_t verified = 0;			///< Candidates that met the boundary.
+	uint64_t failed = 0;			///< Candidates that did not: the device computed wrong.
+	uint64_t dropped = 0;			///< Candidates lost to a full queue.
+
+	// Totals and maxima in microseconds.
+	uint64_t queuedUs = 0;			///< From found to picked up by a verifier thread.
+	uint64_t maxQueuedUs = 0;
+	uint64_t verifyUs = 0;			///< Hashing.
+	uint64_t maxVerifyUs = 0;
+	uint64_t submitUs = 0;			///< Handing verified solutions to the farm.
+	uint64_t maxSubmitUs = 0;
+
+	uint64_t count() const { return verified + failed; }
+	uint64_t avgQueuedUs() const { return count() ? queuedUs / count() : 0; }
+	uint64_t avgVerifyUs() const { return count() ? verifyUs / count() : 0; }
+	uint64_t avgSubmitUs() const { return verified ? submitUs / verified : 0; }
+};
+
+/**
+ * @brief Verifies candidate nonces against the light cache on a small pool of threads,
+ * then submits them to the farm or counts them as failed.
+ *
+ * Miners hand over a candidate and carry on: enqueue() never blocks and never hashes.
+ * The queue is bounded; a candidate arriving when it is full is dropped and counted,
+ * which only happens when the devices report far more than the pool can verify.
+ */
+class SolutionVerifier
+{
+public:
+	static const unsigned c_defaultThreads = 2;
+	static const unsigned c_queueCapacity = 256;
+
+	explicit SolutionVerifier(FarmFace& _farm): m_farm(_farm) {}
+	~SolutionVerifier();
+
+	/// Number of verifier threads; takes effect when the first candidate arrives.
+	static void setThreads(unsigned _threads) { s_threads = _threads ? _threads : 1; }
+
+	/// Queues @a _c for verification. @returns false if the queue was full and it was dropped.
+	bool enqueue(SolutionCandidate&& _c);
+
+	VerifierStats stats() const { Guard l(x_queue); return m_stats; }
+
+private:
+	void verifyLoop();
+	void verify(std::vector<SolutionCandidate>& _batch);
+
+	FarmFace& m_farm;
+
+	mutable Mutex x_queue;
+	std::condition_variable m_queued;
+	std::deque<SolutionCandidate> m_queue;
+	std::vector<std::thread> m_threads;		///< Started with the first candidate.
+	bool m_stopping = false;
+	VerifierStats m_stats;
+
+	static unsigned s_threads;
+};
+
+inline std::ostream& operator<<(std::ostream& _out, VerifierStats const& _s)
+{
+	return _out << "verified " << _s.verified << " failed " << _s.failed << " dropped " << _s.dropped
+		<< ", queued " << _s.avgQueuedUs() << "/" << _s.maxQueuedUs
+		<< " verify " << _s.avgVerifyUs() << "/" << _s.maxVerifyUs
+		<< " submit " << _s.avgSubmitUs() << "/" << _s.maxSubmitUs << " us avg/max";
+}
+
+}
+}
@@ -0,0 +1,82 @@
+/*
+	This file is part of cpp-ethereum.
+
+	cpp-ethereum is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	cpp-ethereum is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file test_seedhash.cpp
+ * Checks ethash_get_seedhash() against the seeds of the EpochRegistry.
+ *
+ * Around the ECIP-1099 fork both halves of a 60000 block epoch must get the seed of
+ * the 30000 block epoch the epoch starts with, the second half included.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <libethash/ethash.h>
+#include "EpochRegistry.h"
+
+using namespace std;
+using namespace dev;
+using namespace eth;
+
+namespace
+{
+
+unsigned s_failures = 0;
+
+void check(uint64_t _block)
+{
+	ethash_h256_t const seed = ethash_get_seedhash(_block);
+	h256 const& expected = EpochRegistry::get().byBlock(_block).seed;
+	if (memcmp(seed.b, expected.data(), sizeof(seed.b)) != 0)
+	{
+		if (s_failures++ < 10)
+			cout << "block " << _block << ": ethash_get_seedhash " << h256((byte const*)seed.b, h256::ConstructFromPointer).hex()
+				<< ", registry " << expected.hex() << endl;
+	}
+}
+
+}
+
+int main()
+{
+	uint64_t const fork = ETCHASH_FORK_BLOCK;
+	uint64_t const blocks[] = {
+		0, 1, ETHASH_EPOCH_LENGTH - 1, ETHASH_EPOCH_LENGTH,
+		fork - ETHASH_EPOCH_LENGTH, fork - 1, fork, fork + 1,
+		// the first and the second half of the first and a later 60000 block epoch
+		fork + ETHASH_EPOCH_LENGTH - 1, fork + ETHASH_EPOCH_LENGTH, fork + ETHASH_EPOCH_LENGTH_NEW - 1,
+		fork + 7 * ETHASH_EPOCH_LENGTH_NEW + 12345, fork + 7 * ETHASH_EPOCH_LENGTH_NEW + ETHASH_EPOCH_LENGTH + 12345,
+	};
+	for (uint64_t b: blocks)
+		check(b);
+	// The ends and the middle of every 16th epoch.
+	EpochRegistry const& epochs = EpochRegistry::get();
+	for (uint64_t b = 0; b < epochs.endBlock(); b = epochs.byBlock(b).lastBlock + 1)
+	{
+		EpochInfo const& e = epochs.byBlock(b);
+		if (e.epoch % 16 != 0)
+			continue;
+		check(e.firstBlock);
+		check((e.firstBlock + e.lastBlock) / 2 + 1);
+		check(e.lastBlock);
+	}
+	if (s_failures)
+	{
+		cout << "ethash_get_seedhash: " << s_failures << " wrong seeds" << endl;
+		return 1;
+	}
+	cout << "ethash_get_seedhash: seeds ok" << endl;
+	return 0;
+}
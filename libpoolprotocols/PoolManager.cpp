@@ -1,4 +1,5 @@
 #include "PoolManager.h"
+#include <libethcore/EpochRegistry.h>
 #include <chrono>
 
 using namespace std;
@@ -33,6 +34,8 @@ PoolManager::PoolManager(PoolClient * client, Farm &farm, MinerType const & mine
 				m_farm.start("opencl", false);
 			else if (m_minerType == MinerType::CUDA)
 				m_farm.start("cuda", false);
+			else if (m_minerType == MinerType::CPU)
+				m_farm.start("cpu", false);
 			else if (m_minerType == MinerType::Mixed) {
 				m_farm.start("cuda", false);
 				m_farm.start("opencl", true);
@@ -54,6 +57,18 @@ PoolManager::PoolManager(PoolClient * client, Farm &farm, MinerType const & mine
 	p_client->onWorkReceived([&](WorkPackage const& wp)
 	{
 		m_reconnectTry = 0;
+		if (wp.seed != m_lastSeed)
+		{
+			EpochInfo const* epoch = EpochRegistry::get().bySeed(wp.seed);
+			if (!epoch)
+			{
+				cwarn << "Ignoring job" << wp.header << "with unknown seed hash" << wp.seed;
+				return;
+			}
+			m_lastSeed = wp.seed;
+			cnote << "New epoch" << EthWhite << epoch->epoch << EthReset << "starting at block" << epoch->firstBlock
+				<< ", DAG size" << epoch->dagSize / (1024 * 1024) << "MB";
+		}
 		m_farm.setWork(wp);
 		if (wp.boundary != m_lastBoundary)
 		{
@@ -127,6 +142,8 @@ PoolManager::PoolManager(PoolClient * client, Farm &farm, MinerType const & mine
 			m_farm.start("opencl", false);
 		else if (m_minerType == MinerType::CUDA)
 			m_farm.start("cuda", false);
+		else if (m_minerType == MinerType::CPU)
+			m_farm.start("cpu", false);
 		else if (m_minerType == MinerType::Mixed) {
 			m_farm.start("cuda", false);
 			m_farm.start("opencl", true);
@@ -39,6 +39,7 @@ namespace dev
 			std::vector <PoolConnection> m_connections;
 			unsigned m_activeConnectionIdx = 0;
 			h256 m_lastBoundary = h256();
+			h256 m_lastSeed = h256{1u};	// Epoch 0 has a zero seed hash.
 
 			PoolClient *p_client;
 			Farm &m_farm;